@@ -32,6 +32,55 @@
 /* MAKE signal input PF6/RESET or other PIN */
 #define ENABLE_MAKE_SIGNAL_OVER_RESET
 
+/* Answer flash page writes before the UPDI store completes */
+/* The next page is received by interrupt while the current page is written */
+#define ENABLE_POSTED_WRITE
+
+/* Forward memory read answers to the host while UPDI is still receiving */
+/* Used only when the host link is not slower than the UPDI link */
+#define ENABLE_STREAM_READ
+
+/* Load the next flash block while the host handles a read answer */
+/* Sequential verify reads are then served from SRAM : uses 512 bytes of SRAM */
+#define ENABLE_READ_AHEAD
+
+/* Leave the target in NVMPROG at sign off and reattach to it in the next session */
+/* Skips the reset pulses, the long BREAK and the key entry of the next session */
+/* The target stays halted after avrdude exits, until the next session or power off */
+// #define ENABLE_WARM_ENTRY
+
+/* Erase up to 32 sequential flash pages at once (NVMCTRL v2,3,4,5) */
+/* Pages following the last written page inside the erased block are lost */
+// #define ENABLE_MULTI_PAGE_ERASE
+
+/* Read back each full flash page first and skip the write if unchanged */
+/* Faster for reflashing a mostly identical image without chip erase */
+// #define ENABLE_DIFFERENTIAL_WRITE
+
+/* NVMCTRL drivers built in : targets of other versions are refused */
+/* A fixture for one device family can drop the rest, e.g. (NVMCTRL_V2) */
+// #define NVMCTRL_VERSIONS (NVMCTRL_V0 | NVMCTRL_V2 | NVMCTRL_V3 | NVMCTRL_V4 | NVMCTRL_V5)
+
+/* Accept CMND_WRITE_MEMORY with the vendor memory type MTYPE_PACKED */
+/* The body is PackBits run-length data, expanded in place before the write */
+// #define ENABLE_PACKED_WRITE
+
+/* Memory reads over 512 bytes in one frame, up to 4 KiB by the SRAM size */
+/* The host enables it with CMND_SET_PARAMETER PARAM_MAX_FRAME */
+#define ENABLE_LARGE_FRAME
+
+/* JTAG2 frame CRC : lookup table is faster, but uses 512 bytes of flash */
+/* Disabling it uses the smaller bitwise _crc_ccitt_update */
+#define ENABLE_CRC_TABLE
+
+/* Timing statistics for each JTAG2 command and UPDI phase */
+/* Read by CMND_GET_PARAMETER PARAM_PROFILE : uses about 550 bytes of SRAM */
+// #define ENABLE_PROFILE
+
+/* Counters of sessions, pages, retries, timeouts etc. since power on */
+/* Read by CMND_GET_PARAMETER PARAM_STATS, cleared by CMND_SET_PARAMETER */
+// #define ENABLE_STATISTICS
+
 /**************************
  * DEBUG mode using USART *
  **************************/
@@ -64,6 +113,9 @@
 /* UPDI default speed: 225000L */
 /* supported rabge : 235000L ~ 45000L */
 #define UPDI_USART_BAUDRATE (225000L / 1)
+/* UPDI high speed after NVMPROG key entry (ASI_CTRLA UPDICLKSEL) */
+/* supported : 1800000L, 900000L, 450000L : comment out to disable */
+#define UPDI_HIGH_BAUDRATE (900000L)
 #define UPDI_ABORT_MS 1200
 #define JTAG_ABORT_MS 12000
 #define HVP_ENABLE_DELAY_US 800
@@ -104,6 +156,13 @@
   /* Disable DEBUG mode */
   #undef DEBUG
 
+  /* Not enough SRAM for the read-ahead buffer */
+  #undef ENABLE_READ_AHEAD
+
+  /* Not enough SRAM for a receive ring holding the next page frame */
+  /* 1 KiB on the ATtiny824 : the 533 byte packet already takes half */
+  #undef ENABLE_POSTED_WRITE
+
   #define PGEN_USE_PORTA
   #define PGEN_PIN 7
   // #define PGEN_PIN_INVERT
@@ -130,6 +189,7 @@
   #define UPDI_TRST_PIN 3
 
   #define JTAG_USART_MODULE USART1
+  #define JTAG_USART_RXC_vect USART1_RXC_vect
   #define JTAG_USART_PORT PORTA
   #define JTAG_JTTX_PIN 1
   #define JTAG_JTRX_PIN 2
@@ -166,6 +226,7 @@
    *  HVEN  : A1:PD2  --> HV output state               : LOW:Disable, HIGH:Enable
    *  HVP1  : A2:PD3  --> Charge pump drive 1 (optional)
    *  HVP2  : A3:PD4  --> Charge pump drive 2 (optional)
+   *  STRAP : A4:PD5  <-- Image store replay strap      : LOW:Standalone, HIGH:Host (optional)
    */
 
   #define PGEN_USE_PORTA
@@ -202,7 +263,30 @@
   // #define UPDI_TDIR_PIN_INVERT
   #define UPDI_TRST_PIN 1
 
+  /* Gang programming : more targets on more USARTs, driven in lock-step */
+  /* TDAT of each is the TXD pin of the module (open-drain loopback) */
+  /* One entry per module : USART, PINnCTRL of its TXD pin, route register, route */
+  /* USART0-3 route in USARTROUTEA, USART4-5 in USARTROUTEB (48 and 64 pin parts) */
+  /* TDIR and TRST are shared, HV programming uses the primary only */
+  /* #define UPDI_GANG_MODULES \
+       { &USART3, &PORTB.PIN0CTRL, &PORTMUX.USARTROUTEA, PORTMUX_USART3_DEFAULT_gc }, \
+       { &USART4, &PORTE.PIN0CTRL, &PORTMUX.USARTROUTEB, PORTMUX_USART4_DEFAULT_gc } */
+
+  /* On-programmer image store (AVR Dx host only) */
+  /* PARAM_STORE records the flash writes of a session into the host flash */
+  /* and, when armed, the MAKE signal replays them to each new target */
+  /* Replay needs the strap pin tied low : a host opening the port is ignored */
+  /* The store area must be APPDATA : set FUSE.BOOTSIZE and FUSE.CODESIZE */
+  #ifdef __AVR_DX__
+    // #define ENABLE_IMAGE_STORE
+    #define IMAGE_STORE_ADDR (0x10000L)
+    #define IMAGE_STORE_SIZE (0x10000L)
+    #define IMAGE_STORE_STRAP_PORT PORTD
+    #define IMAGE_STORE_STRAP_PIN 5
+  #endif
+
   #define JTAG_USART_MODULE USART0
+  #define JTAG_USART_RXC_vect USART0_RXC_vect
   // #define JTAG_USART_PORTMUX (PORTMUX_USART0_DEFAULT_gc)
   #define JTAG_USART_PORT PORTA
   #define JTAG_JTTX_PIN 0
@@ -290,6 +374,7 @@
   #define UPDI_TRST_PIN 5
 
   #define JTAG_USART_MODULE USART3
+  #define JTAG_USART_RXC_vect USART3_RXC_vect
   #define JTAG_USART_PORTMUX (PORTMUX_USART3_ALT1_gc)
   #define JTAG_USART_PORT PORTB
   #define JTAG_JTTX_PIN 4
@@ -371,6 +456,7 @@
   // #define UPDI_TDIR_PIN_INVERT
 
   #define JTAG_USART_MODULE USART3
+  #define JTAG_USART_RXC_vect USART3_RXC_vect
   #define JTAG_USART_PORTMUX (PORTMUX_USART3_ALT1_gc)
   #define JTAG_USART_PORT PORTB
   #define JTAG_JTTX_PIN 4
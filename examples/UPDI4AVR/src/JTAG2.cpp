@@ -9,6 +9,7 @@
  *
  */
 #include <util/atomic.h>
+#include <avr/pgmspace.h>
 #include "sys.h"
 #include "JTAG2.h"
 #include "UPDI.h"
@@ -16,6 +17,8 @@
 #include "usart.h"
 #include "timer.h"
 #include "abort.h"
+#include "prof.h"
+#include "store.h"
 #include "dbg.h"
 
 namespace JTAG2 {
@@ -23,7 +26,18 @@ namespace JTAG2 {
   uint8_t CONTROL;
   jtag_baud_rate_e PARAM_BAUD_RATE_VAL;
   jtag_packet_t packet;
-  uint8_t eeprom_pagesize;
+  bool body_blank;          // write data of the last frame is all $FF
+  uint16_t frame_limit = DEFAULT_READ_SIZE;
+  uint32_t posted_addr;     // start address of the posted write that failed
+
+  /* Interrupt receive ring buffer */
+  uint8_t rx_buffer[RX_BUFFER_SIZE];
+  volatile uint16_t rx_head;
+  volatile uint16_t rx_tail;
+
+  /* Streaming answer running CRC and body bytes still owed */
+  uint16_t stream_crc;
+  size_t stream_left;
 
   const uint16_t BAUD_TABLE[] = {
       BAUD_REG_VAL(2400)    // 0: not used dummy
@@ -56,6 +70,43 @@ namespace JTAG2 {
     , BAUD_REG_VAL(2000000) // F_CPU 16Mhz max limit
     , BAUD_REG_VAL(3000000) // F_CPU 24Mhz over
   };
+  #ifdef ENABLE_CRC_TABLE
+  /* CRC-CCITT (reflected 0x8408) : same result as _crc_ccitt_update */
+  const uint16_t CRC_TABLE[256] PROGMEM = {
+      0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF
+    , 0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7
+    , 0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E
+    , 0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876
+    , 0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD
+    , 0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5
+    , 0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C
+    , 0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974
+    , 0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB
+    , 0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3
+    , 0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A
+    , 0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72
+    , 0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9
+    , 0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1
+    , 0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738
+    , 0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70
+    , 0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7
+    , 0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF
+    , 0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036
+    , 0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E
+    , 0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5
+    , 0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD
+    , 0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134
+    , 0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C
+    , 0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3
+    , 0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB
+    , 0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232
+    , 0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A
+    , 0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1
+    , 0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9
+    , 0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330
+    , 0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
+  };
+  #endif
   const uint8_t sign_on_resp[] = {
       JTAG2::RSP_SIGN_ON  // $00: MESSAGE_ID   : $86
     , 0x01                // $01: COMM_ID      : Communications protocol version
@@ -79,6 +130,16 @@ namespace JTAG2 {
   };
 }
 
+/* Intrrupt handler */
+ISR(JTAG_USART_RXC_vect) {
+  uint8_t _data = USART::read(&JTAG_USART_MODULE);
+  uint16_t _next = (JTAG2::rx_head + 1) & (JTAG2::RX_BUFFER_SIZE - 1);
+  /* overflow data is discarded and detected by CRC */
+  if (_next == JTAG2::rx_tail) return;
+  JTAG2::rx_buffer[JTAG2::rx_head] = _data;
+  JTAG2::rx_head = _next;
+}
+
 void JTAG2::setup (void) {
   JTAG2::CONTROL = 0;
   JTAG2::PARAM_BAUD_RATE_VAL = JTAG2::BAUD_19200;
@@ -93,7 +154,7 @@ void JTAG2::setup (void) {
   USART::setup(
     &JTAG_USART_MODULE,
     JTAG2::BAUD_TABLE[JTAG2::PARAM_BAUD_RATE_VAL],
-    (0x00),
+    (USART_RXCIE_bm),
     (USART_RXEN_bm),
     (USART_CHSIZE_8BIT_gc | USART_PMODE_DISABLED_gc | USART_CMODE_ASYNCHRONOUS_gc | USART_SBMODE_1BIT_gc)
   );
@@ -120,13 +181,21 @@ bool JTAG2::transfer_enable (void) {
 void JTAG2::transfer_disable (void) {
   if (JTAG2::is_control(JTAG2::USART_TX_EN)) {
     /* Close the JTAG transmit port and reset the device. */
-    loop_until_bit_is_set(JTAG_USART_MODULE.STATUS, USART_TXCIF_bp);
+    while (!USART::is_tx_complete(&JTAG_USART_MODULE));
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
       JTAG_USART_MODULE.CTRLB &= ~USART_TXEN_bm;
     }
     PIN_CTRL(JTAG_USART_PORT,JTAG_JTTX_PIN) = PORT_ISC_INPUT_DISABLE_gc;
     JTAG_USART_PORT.DIRCLR = _BV(JTAG_JTTX_PIN);
-    if (UPDI::is_control(UPDI::UPDI_ACTIVE)) {
+    #ifdef ENABLE_WARM_ENTRY
+    /* Stay in NVMPROG for the next session : no LEAVE and no reset pulse */
+    bool _hold = UPDI::NVMPROG_HELD
+      && UPDI::is_control(UPDI::UPDI_ACTIVE)
+      && !UPDI::is_control(UPDI::CHIP_ERASE | UPDI::UPDI_FALT | UPDI::UPDI_TIMEOUT);
+    #else
+    constexpr bool _hold = false;
+    #endif
+    if (UPDI::is_control(UPDI::UPDI_ACTIVE) && !_hold) {
       /* Log out from the device's UDPI. */
       UPDI::runtime(UPDI::UPDI_CMD_LEAVE);
     }
@@ -138,9 +207,11 @@ void JTAG2::transfer_disable (void) {
       _PROTECTED_WRITE(WDT_CTRLA, WDT_PERIOD_64CLK_gc);
     }
     SYS::pgen_disable();
-    SYS::trst_enable();
-    TIMER::delay_us(250);
-    SYS::trst_disable();
+    if (!_hold) {
+      SYS::trst_enable();
+      TIMER::delay_us(250);
+      SYS::trst_disable();
+    }
     #ifdef DEBUG_USE_USART
     DBG::print("(TX_OF)", false);
     #endif
@@ -149,10 +220,17 @@ void JTAG2::transfer_disable (void) {
 
 void JTAG2::change_baudrate (bool wait) {
   if (wait) {
-    loop_until_bit_is_set(JTAG_USART_MODULE.STATUS, USART_TXCIF_bp);
+    while (!USART::is_tx_complete(&JTAG_USART_MODULE));
   }
   USART::change_baudrate(&JTAG_USART_MODULE, JTAG2::BAUD_TABLE[JTAG2::PARAM_BAUD_RATE_VAL]);
   JTAG2::clear_control(JTAG2::CHANGE_BAUD);
+  JTAG2::flush();
+}
+
+void JTAG2::flush (void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    JTAG2::rx_tail = JTAG2::rx_head;
+  }
 }
 
 void JTAG2::answer_transfer (void) {
@@ -160,19 +238,84 @@ void JTAG2::answer_transfer (void) {
   DBG::print("$", false);
   DBG::write_hex(packet.body[0]);
   #endif
+  #ifdef ENABLE_PROFILE
+  uint32_t _prof = PROF::start();
+  #endif
   uint16_t crc = ~0;
   int16_t len = packet.size_word[0] + 8;
-  uint8_t *p = &packet.soh;
-  uint8_t *q = &packet.soh;
+  uint8_t *p = packet.raw;
+  uint8_t *q = packet.raw;
   if (packet.body[0] >= JTAG2::RSP_FAILED) {
     JTAG2::set_control(JTAG2::ANS_FAILED);
   }
-  while (len--) crc = JTAG2::crc16_update(crc, *q++);
+  crc = JTAG2::crc16_block(crc, q, len);
+  q += len;
   (*q++) = crc;
   (*q++) = crc >> 8;
-  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-    while (p != q) JTAG2::put(*p++);
-  }
+  /* Reception is interrupt driven, so the transmit loop keeps
+    interrupts enabled and the millisecond tick keeps counting. */
+  while (p != q) JTAG2::put(*p++);
+  #ifdef ENABLE_PROFILE
+  PROF::stop(PROF::PROF_ANSWER, _prof);
+  #endif
+}
+
+/* Answer RSP_OK in advance without touching the request body */
+void JTAG2::answer_posted (void) {
+  uint8_t _ans[11] = {
+      MESSAGE_START
+    , packet.number_byte[0], packet.number_byte[1]
+    , 1, 0, 0, 0
+    , TOKEN
+    , JTAG2::RSP_OK
+  };
+  uint16_t crc = JTAG2::crc16_block(~0, &_ans[0], 9);
+  uint8_t *p = &_ans[9];
+  (*p++) = crc;
+  (*p++) = crc >> 8;
+  p = &_ans[0];
+  for (uint8_t i = 0; i < sizeof(_ans); i++) JTAG2::put(*p++);
+  JTAG2::set_control(JTAG2::ANS_POSTED);
+}
+
+/* The host link must drain faster than UPDI fills, or UPDI bytes are lost */
+bool JTAG2::stream_ready (void) {
+  uint16_t jtag_baud = JTAG_USART_MODULE.BAUD;
+  uint16_t updi_baud = UPDI_USART_MODULE.BAUD;
+  if (JTAG_USART_MODULE.CTRLB & USART_RXMODE_CLK2X_gc) jtag_baud >>= 1;
+  if (UPDI_USART_MODULE.CTRLB & USART_RXMODE_CLK2X_gc) updi_baud >>= 1;
+  return jtag_baud <= updi_baud;
+}
+
+/* Send the frame header now, the body follows with stream_put */
+void JTAG2::stream_begin (jtag_response_e response_code, size_t len) {
+  packet.size = len;
+  packet.body[0] = response_code;
+  JTAG2::stream_crc = JTAG2::crc16_block(~0, packet.raw, 9);
+  uint8_t *p = packet.raw;
+  for (uint8_t i = 0; i < 9; i++) JTAG2::put(*p++);
+  JTAG2::stream_left = len - 1;
+  JTAG2::set_control(JTAG2::ANS_POSTED);
+}
+
+void JTAG2::stream_put (uint8_t data) {
+  JTAG2::stream_crc = JTAG2::crc16_update(JTAG2::stream_crc, data);
+  JTAG2::stream_left--;
+  JTAG2::put(data);
+}
+
+void JTAG2::stream_end (void) {
+  JTAG2::put(JTAG2::stream_crc);
+  JTAG2::put(JTAG2::stream_crc >> 8);
+}
+
+/* A stream cut short still ends at its stated length, but with a spoiled */
+/* CRC : the host drops the frame and retries instead of waiting for it */
+void JTAG2::stream_abort (void) {
+  if (JTAG2::stream_left == 0) return;
+  do JTAG2::stream_put(0xFF); while (JTAG2::stream_left);
+  JTAG2::stream_crc = ~JTAG2::stream_crc;
+  JTAG2::stream_end();
 }
 
 bool JTAG2::answer_after_change (void) {
@@ -193,29 +336,51 @@ bool JTAG2::answer_after_change (void) {
 
 /* blocked character get */
 uint8_t JTAG2::get (void) {
-  loop_until_bit_is_set(JTAG_USART_MODULE.STATUS, USART_RXCIF_bp);
-  return JTAG_USART_MODULE.RXDATAL;
+  uint16_t _head;
+  do {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      _head = JTAG2::rx_head;
+    }
+  } while (_head == JTAG2::rx_tail);
+  uint8_t _data = JTAG2::rx_buffer[JTAG2::rx_tail];
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    JTAG2::rx_tail = (JTAG2::rx_tail + 1) & (JTAG2::RX_BUFFER_SIZE - 1);
+  }
+  return _data;
 }
 
 uint8_t JTAG2::put (uint8_t data) {
-  loop_until_bit_is_set(JTAG_USART_MODULE.STATUS, USART_DREIF_bp);
-  JTAG_USART_MODULE.STATUS |= USART_TXCIF_bm;
-  return JTAG_USART_MODULE.TXDATAL = data;
+  while (!USART::is_tx_ready(&JTAG_USART_MODULE));
+  USART::write(&JTAG_USART_MODULE, data);
+  return data;
 }
 
 uint16_t JTAG2::crc16_update(uint16_t crc, uint8_t data) {
+  #ifdef ENABLE_CRC_TABLE
+  return (crc >> 8) ^ pgm_read_word(&JTAG2::CRC_TABLE[(uint8_t)crc ^ data]);
+  #else
   return _crc_ccitt_update(crc, data);
+  #endif
+}
+
+uint16_t JTAG2::crc16_block(uint16_t crc, const uint8_t *data, size_t len) {
+  while (len--) crc = JTAG2::crc16_update(crc, *data++);
+  return crc;
 }
 
 bool JTAG2::packet_receive (void) {
-  uint16_t crc = ~0;
-  uint8_t *p = &packet.soh;
-  uint8_t *q = &packet.soh;
+  uint16_t crc;
+  uint8_t *p = packet.raw;
   while (JTAG2::get() != MESSAGE_START);
+  #ifdef ENABLE_PROFILE
+  uint32_t _prof = PROF::start();
+  #endif
   ABORT::start_timer(ABORT::CONTEXT, JTAG_ABORT_MS);
   ABORT::set_make_interrupt(ABORT::CONTEXT);
   (*p++) = MESSAGE_START;
-  for (int16_t i = 0; i < 7; i++) (*p++) = JTAG2::get();
+  crc = JTAG2::crc16_update(~0, MESSAGE_START);
+  /* The CRC is accumulated as each byte arrives */
+  for (int16_t i = 0; i < 7; i++) crc = JTAG2::crc16_update(crc, (*p++) = JTAG2::get());
   if (packet.stx != TOKEN) {
     #ifdef DEBUG_USE_USART
     DBG::print("!token");
@@ -228,17 +393,70 @@ bool JTAG2::packet_receive (void) {
     #endif
     return false;
   }
-  for (int16_t i = -2; i < packet.size_word[0]; i++) (*p++) = JTAG2::get();
-  while (p != q) crc = JTAG2::crc16_update(crc, *q++);
+  /* body[10] and after : CMND_WRITE_MEMORY data, checked for blank */
+  uint8_t _blank = 0xFF;
+  int16_t _end = packet.size_word[0] - 2;
+  for (int16_t i = -2; i < packet.size_word[0]; i++) {
+    uint8_t _data = JTAG2::get();
+    crc = JTAG2::crc16_update(crc, (*p++) = _data);
+    if (i >= 8 && i < _end) _blank &= _data;
+  }
+  JTAG2::body_blank = _blank == 0xFF && _end > 8;
   if (crc != 0) {
     #ifdef DEBUG_USE_USART
     DBG::print("!crc");
     #endif
     return false;
   }
+  #ifdef ENABLE_PROFILE
+  PROF::stop(PROF::PROF_RECEIVE, _prof);
+  #endif
   return true;
 }
 
+#ifdef ENABLE_PACKED_WRITE
+/*
+ * CMND_WRITE_MEMORY MTYPE_PACKED : body[2] is the expanded byte count,
+ * body[10] the real memory type and body[11] on PackBits (TIFF) data.
+ *   0..127   : copy the next n+1 bytes
+ *   129..255 : repeat the next byte 257-n times
+ *   128      : no operation
+ * body_size is the received size : packet.size already holds the answer size.
+ * The data is moved to the end of the body and expanded to body[10].
+ * Output must never pass the input, so the expansion needs no other buffer.
+ */
+bool JTAG2::unpack (size_t body_size) {
+  size_t _count = *((uint32_t*)&packet.body[2]);
+  size_t _len = body_size - 11;
+  if (body_size < 11 || _count > sizeof(packet.body) - 10) return false;
+  packet.body[1] = packet.body[10];
+  uint8_t *q = &packet.body[sizeof(packet.body) - _len];
+  uint8_t *e = &packet.body[sizeof(packet.body)];
+  uint8_t *p = &packet.body[10];
+  uint8_t *z = &packet.body[10 + _count];
+  memmove(q, &packet.body[11], _len);
+  uint8_t _blank = 0xFF;
+  while (q < e) {
+    uint8_t n = *q++;
+    if (n < 128) {
+      if (q + n >= e || p + n >= z) return false;
+      do _blank &= (*p++ = *q++); while (n--);
+    }
+    else if (n > 128) {
+      if (q >= e) return false;
+      uint8_t _data = *q++;
+      n = 257 - n;
+      if (p + n > z || p + n > q) return false;
+      _blank &= _data;
+      do *p++ = _data; while (--n);
+    }
+  }
+  if (p != z) return false;
+  JTAG2::body_blank = _blank == 0xFF && _count;
+  return true;
+}
+#endif
+
 void JTAG2::set_response (jtag_response_e response_code) {
   packet.size = 3;
   packet.body[0] = response_code;
@@ -255,6 +473,7 @@ void JTAG2::sign_off (void) {
 bool JTAG2::sign_on (void) {
   if (JTAG2::transfer_enable()) {
     JTAG2::set_control(JTAG2::HOST_SIGN_ON);
+    JTAG2::frame_limit = JTAG2::DEFAULT_READ_SIZE;
     packet.size = sizeof(sign_on_resp);
     for (uint8_t i = 0; i < sizeof(sign_on_resp); i++) {
       packet.body[i] = sign_on_resp[i];
@@ -294,6 +513,48 @@ void JTAG2::set_parameter (void) {
     case JTAG2::PARAM_EMU_MODE : {
       break;
     }
+    #ifdef ENABLE_PROFILE
+    case JTAG2::PARAM_PROFILE : {
+      PROF::clear();
+      break;
+    }
+    #endif
+    #ifdef ENABLE_STATISTICS
+    case JTAG2::PARAM_STATS : {
+      PROF::stats_clear();
+      break;
+    }
+    #endif
+    case JTAG2::PARAM_MAX_FRAME : {
+      /* uint16 : requested read size, granted up to MAX_READ_SIZE */
+      uint16_t _limit = *((uint16_t*)&packet.body[2]);
+      if (_limit < JTAG2::DEFAULT_READ_SIZE || (_limit & 1)) {
+        JTAG2::set_response(JTAG2::RSP_ILLEGAL_VALUE);
+        return;
+      }
+      JTAG2::frame_limit = _limit < JTAG2::MAX_READ_SIZE ? _limit : JTAG2::MAX_READ_SIZE;
+      #ifdef DEBUG_USE_USART
+      DBG::print(" FRAME=", false);
+      DBG::print_dec(JTAG2::frame_limit);
+      #endif
+      break;
+    }
+    #ifdef UPDI_GANG_MODULES
+    case JTAG2::PARAM_GANG : {
+      UPDI::gang_restore();
+      break;
+    }
+    #endif
+    #ifdef ENABLE_IMAGE_STORE
+    case JTAG2::PARAM_STORE : {
+      if (param_val > STORE::STORE_ARMED) {
+        JTAG2::set_response(JTAG2::RSP_ILLEGAL_VALUE);
+        return;
+      }
+      STORE::set_state(param_val);
+      break;
+    }
+    #endif
     case JTAG2::PARAM_BAUD_RATE : {
       if ((param_val >= JTAG2::BAUD_LOWER) && (param_val <= JTAG2::BAUD_UPPER)) {
         JTAG2::PARAM_BAUD_RATE_VAL = (jtag_baud_rate_e) param_val;
@@ -369,6 +630,61 @@ void JTAG2::get_parameter (void) {
       packet.body[2] = PARAM_VTARGET_VAL >> 8;
       break;
     }
+    case JTAG2::PARAM_UPDI_BAUD : {
+      #ifdef DEBUG_USE_USART
+      DBG::print(" UBAUD=", false);
+      DBG::print_dec(UPDI::BAUDRATE);
+      #endif
+      packet.size_word[0] = 5;
+      *((uint32_t*)&packet.body[1]) = UPDI::BAUDRATE;
+      break;
+    }
+    case JTAG2::PARAM_MAX_FRAME : {
+      /* uint16 : granted read size, uint16 : largest read size */
+      packet.size_word[0] = 5;
+      *((uint16_t*)&packet.body[1]) = JTAG2::frame_limit;
+      *((uint16_t*)&packet.body[3]) = JTAG2::MAX_READ_SIZE;
+      break;
+    }
+    #ifdef UPDI_GANG_MODULES
+    case JTAG2::PARAM_GANG : {
+      /* bit n : secondary target n is still in step with the primary */
+      packet.size_word[0] = 2;
+      packet.body[1] = UPDI::GANG_ACTIVE;
+      break;
+    }
+    #endif
+    #ifdef ENABLE_IMAGE_STORE
+    case JTAG2::PARAM_STORE : {
+      /* uint8 : state, uint16 : stored flash pages */
+      packet.size_word[0] = 4;
+      packet.body[1] = STORE::STATE;
+      *((uint16_t*)&packet.body[2]) = STORE::count();
+      break;
+    }
+    #endif
+    #ifdef ENABLE_STATISTICS
+    case JTAG2::PARAM_STATS : {
+      /* PROF::stat_counter_t : uint32 counters since power on or clear */
+      packet.size_word[0] = 1 + sizeof(PROF::stat_counter_t);
+      memcpy(&packet.body[1], &PROF::stats, sizeof(PROF::stat_counter_t));
+      break;
+    }
+    #endif
+    #ifdef ENABLE_PROFILE
+    case JTAG2::PARAM_PROFILE : {
+      /* optional body[2] : slot number (PROF::prof_slot_e) */
+      /* packet.size is the answer size here : process_command zeroes a missing slot */
+      uint8_t _slot = packet.body[2];
+      if (_slot >= PROF::PROF_SLOTS) {
+        JTAG2::set_response(JTAG2::RSP_ILLEGAL_VALUE);
+        return;
+      }
+      packet.size_word[0] = 1 + sizeof(PROF::prof_record_t);
+      memcpy(&packet.body[1], &PROF::records[_slot], sizeof(PROF::prof_record_t));
+      break;
+    }
+    #endif
     default : {
       JTAG2::set_response(JTAG2::RSP_ILLEGAL_PARAMETER);
       return;
@@ -380,19 +696,19 @@ void JTAG2::get_parameter (void) {
 void JTAG2::set_device_descriptor (void) {
   // uiFlashPageSize
   NVM::flash_pagesize = *((uint16_t*)&packet.body[0x0f4]);
-  #ifdef DEBUG_USE_USART
-  // ucEepromPageSize
-  eeprom_pagesize = packet.body[0x0f6];
   // ulFlashSize
-  uint32_t flash_areasize = *((uint32_t*)&packet.body[0x0fd]);
+  NVM::flash_size = *((uint32_t*)&packet.body[0x0fd]);
+  // ucEepromPageSize
+  NVM::eeprom_pagesize = packet.body[0x0f6];
+  #ifdef DEBUG_USE_USART
   // uiFlashpages
   uint16_t flash_pageunit = *((uint16_t*)&packet.body[0x11a]);
   DBG::print(" FPS=", false);
   DBG::print_dec(NVM::flash_pagesize);
   DBG::print(" EPS=", false);
-  DBG::print_dec(eeprom_pagesize);
+  DBG::print_dec(NVM::eeprom_pagesize);
   DBG::print(" FAS=", false);
-  DBG::print_dec(flash_areasize);
+  DBG::print_dec(NVM::flash_size);
   DBG::print(" FPU=", false);
   DBG::print_dec(flash_pageunit);
   #ifdef DEBUG_DUMP_DESCRIPTOR
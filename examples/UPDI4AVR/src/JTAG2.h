@@ -26,6 +26,13 @@ namespace JTAG2 {
     , PARAM_EMU_MODE  = 0x03
     , PARAM_BAUD_RATE = 0x05
     , PARAM_VTARGET   = 0x06
+    /* vendor extension */
+    , PARAM_UPDI_BAUD = 0xE0
+    , PARAM_PROFILE   = 0xE1
+    , PARAM_MAX_FRAME = 0xE2
+    , PARAM_GANG      = 0xE3
+    , PARAM_STORE     = 0xE5
+    , PARAM_STATS     = 0xE6
   };
 
   /* valid values for PARAM_BAUD_RATE_VAL */
@@ -88,6 +95,8 @@ namespace JTAG2 {
       HOST_SIGN_ON  = 0x01
     , USART_TX_EN   = 0x02
     , CHANGE_BAUD   = 0x04
+    , ANS_POSTED    = 0x08
+    , POSTED_FALT   = 0x10
     , ANS_FAILED    = 0x80
   };
 
@@ -149,6 +158,8 @@ namespace JTAG2 {
     , MTYPE_EEPROM_XMEGA  = 0xC4   // xmega EEPROM in debug mode
     , MTYPE_USERSIG       = 0xC5   // xmega user signature
     , MTYPE_PRODSIG       = 0xC6   // xmega production signature
+    /* vendor extension */
+    , MTYPE_PACKED        = 0xE0   // body[10] real type, PackBits data after
   };
 
   /* CMND_XMEGA_ERASE sub-command */
@@ -168,11 +179,27 @@ namespace JTAG2 {
   extern uint8_t PARAM_EMU_MODE_VAL;
   extern jtag_baud_rate_e PARAM_BAUD_RATE_VAL;
   extern uint16_t flash_pagesize;
+  extern bool body_blank;
+  extern uint16_t frame_limit;
+  extern uint32_t posted_addr;
 
   /* JTAG2 packet */
   constexpr uint8_t MESSAGE_START = 0x1B; /* SOH */
   constexpr uint8_t TOKEN = 0x0E;         /* STX */
-  constexpr int MAX_BODY_SIZE = 512 + 4 + 4 + 1;
+  /* Largest CMND_READ_MEMORY answer : 512 unless the host negotiates more */
+  constexpr uint16_t DEFAULT_READ_SIZE = 512;
+  #if !defined(ENABLE_LARGE_FRAME)
+  constexpr uint16_t MAX_READ_SIZE = 512;
+  #elif INTERNAL_SRAM_SIZE >= 16384
+  constexpr uint16_t MAX_READ_SIZE = 4096;
+  #elif INTERNAL_SRAM_SIZE >= 8192
+  constexpr uint16_t MAX_READ_SIZE = 2048;
+  #elif INTERNAL_SRAM_SIZE >= 6144
+  constexpr uint16_t MAX_READ_SIZE = 1024;
+  #else
+  constexpr uint16_t MAX_READ_SIZE = 512;
+  #endif
+  constexpr int MAX_BODY_SIZE = MAX_READ_SIZE + 4 + 4 + 1;
   union jtag_packet_t {
     uint8_t _pad;                         // alignment padding
     uint8_t raw[MAX_BODY_SIZE + 1 + 4 + 4 + 1 + 2];
@@ -193,17 +220,37 @@ namespace JTAG2 {
     };
   } extern packet;
 
+  /* Receive ring buffer : the next request arrives here during a UPDI write */
+  #if defined(ENABLE_POSTED_WRITE)
+  constexpr uint16_t RX_BUFFER_SIZE = 1024;
+  /* Largest CMND_WRITE_MEMORY data answered early : the whole next frame must fit */
+  /* frame = header 8 + body 10 + data + CRC 2, ring buffer holds SIZE - 1 */
+  constexpr uint16_t MAX_POSTED_SIZE = RX_BUFFER_SIZE - 1 - 8 - 10 - 2;
+  #else
+  /* The host waits for every answer : the ring only decouples the interrupt */
+  constexpr uint16_t RX_BUFFER_SIZE = 32;
+  #endif
+
   /* methods */
   void setup (void);
   bool transfer_enable (void);
   void transfer_disable (void);
   void change_baudrate (bool wait = false);
+  void flush (void);
   uint8_t get (void);
   uint8_t put (uint8_t data);
   uint16_t crc16_update(uint16_t crc, uint8_t data);
+  uint16_t crc16_block(uint16_t crc, const uint8_t *data, size_t len);
   bool packet_receive (void);
   void answer_transfer (void);
+  void answer_posted (void);
+  bool stream_ready (void);
+  void stream_begin (jtag_response_e response_code, size_t len);
+  void stream_put (uint8_t data);
+  void stream_end (void);
+  void stream_abort (void);
   bool answer_after_change (void);
+  bool unpack (size_t body_size);
   void set_response (jtag_response_e response_code);
 
   inline uint8_t is_control (uint8_t value) {
@@ -13,34 +13,117 @@
 #include "UPDI.h"
 #include "usart.h"
 #include "sys.h"
+#include "timer.h"
+#include "abort.h"
+#include "prof.h"
+#include "store.h"
 #include "dbg.h"
 
 namespace NVM {
   struct fuse_packet_t { uint16_t data; uint16_t addr; };
-  static uint8_t set_ptr[] = {
-      UPDI::UPDI_SYNCH
-    , UPDI::UPDI_ST | UPDI::UPDI_PTR_REG | UPDI::UPDI_DATA3
-    , 0, 0, 0, 0        // $02:24bit address
-  };
-  static uint8_t set_repeat[] = {
-      UPDI::UPDI_SYNCH
-    , UPDI::UPDI_REPEAT | UPDI::UPDI_DATA1
-    , 0                 // $03:repeat count
-    , UPDI::UPDI_SYNCH
-    , UPDI::UPDI_ST | UPDI::UPDI_PTR_INC | UPDI::UPDI_DATA1
-  };
-  static uint8_t set_repeat_rsd[] = {
-      UPDI::UPDI_SYNCH
-    , UPDI::UPDI_STCS    | UPDI::UPDI_CS_CTRLA
-    , UPDI::UPDI_SET_RSD | UPDI::UPDI_SET_GTVAL_2
-    , UPDI::UPDI_SYNCH
-    , UPDI::UPDI_REPEAT  | UPDI::UPDI_DATA1
-    , 0                 // $05:repeat count
-    , UPDI::UPDI_SYNCH
-    , UPDI::UPDI_ST | UPDI::UPDI_PTR_INC | UPDI::UPDI_DATA2
-  };
   uint32_t before_addr = ~0;
   uint16_t flash_pagesize;
+  uint32_t flash_size;
+  uint8_t eeprom_pagesize;
+
+  /* Page erase planner : FLPER + erase_order = FLMPER(1 << erase_order) */
+  uint8_t  erase_order;
+  uint8_t  erase_sequence;
+  uint32_t erase_begin;
+  uint32_t erase_end;
+
+  /* false : The page is already erased by a previous multi-page erase */
+  bool erase_plan (uint32_t block_addr) {
+    erase_order = 0;
+    #ifdef ENABLE_MULTI_PAGE_ERASE
+    if (NVM::version() != '0') {
+      if (before_addr + flash_pagesize == block_addr) {
+        if (erase_sequence < 255) erase_sequence++;
+        if (block_addr >= erase_begin && block_addr < erase_end) return false;
+      }
+      else {
+        erase_sequence = 0;
+      }
+      /* never erase more pages ahead than have been written in sequence */
+      while (erase_order < 5
+        && (2 << erase_order) <= erase_sequence + 1
+        && (block_addr & (((uint32_t)flash_pagesize << (erase_order + 1)) - 1)) == 0
+      ) erase_order++;
+      erase_begin = block_addr;
+      erase_end = block_addr + ((uint32_t)flash_pagesize << erase_order);
+    }
+    #endif
+    return true;
+  }
+
+  /* Adaptive busy wait : learned completion time in usec */
+  uint8_t  wait_class;
+  uint8_t  wait_version;
+  uint16_t wait_issued;
+  uint16_t wait_learned[WAIT_CLASSES];
+
+  /* Initial estimate : a safe fraction of the datasheet figures */
+  const uint16_t wait_seed[][WAIT_CLASSES] = {
+      { 0, 1500, 1500, 1500 }   // NVMCTRL v0 : ER, WP/ERWP
+    , { 0, 5000,    0, 5000 }   // NVMCTRL v2,4 : FLPER, FLWR, EEERWR
+    , { 0, 3000, 1000, 1000 }   // NVMCTRL v3,5 : FLPER, FLPW, EEPERW
+  };
+
+  /* Longest believable completion time : anything above is not learned */
+  const uint16_t wait_limit[][WAIT_CLASSES] = {
+      { 0,  8000,  8000,  8000 }  // NVMCTRL v0
+    , { 0, 20000,  2000, 20000 }  // NVMCTRL v2,4
+    , { 0, 12000,  6000,  6000 }  // NVMCTRL v3,5
+  };
+
+  uint8_t wait_family (void) {
+    uint8_t _v = NVM::version();
+    return _v == '0' ? 0 : (_v == '2' || _v == '4') ? 1 : 2;
+  }
+
+  uint8_t wait_class_of (uint8_t nvmcmd) {
+    if (NVM::version() == '0') {
+      if (nvmcmd == NVM_CMD_ER) return WAIT_ERASE;
+      if (nvmcmd == NVM_CMD_WP || nvmcmd == NVM_CMD_ERWP) return WAIT_WRITE;
+      return WAIT_NONE;
+    }
+    switch (nvmcmd) {
+      case NVM_V2_CMD_FLPER :
+      case NVM_V2_CMD_FLMPER2 :
+      case NVM_V2_CMD_FLMPER4 :
+      case NVM_V2_CMD_FLMPER8 :
+      case NVM_V2_CMD_FLMPER16 :
+      case NVM_V2_CMD_FLMPER32 :
+        return WAIT_ERASE;
+      case NVM_V2_CMD_FLWR :
+      case NVM_V3_CMD_FLPW :
+      case NVM_V3_CMD_FLPERW :
+        return WAIT_WRITE;
+      case NVM_V2_CMD_EEWR :
+      case NVM_V2_CMD_EEERWR :
+      case NVM_V3_CMD_EEPW :
+      case NVM_V3_CMD_EEPERW :
+      case NVM_V3_CMD_EEPER :
+        return WAIT_EEPROM;
+    }
+    return WAIT_NONE;
+  }
+
+  #ifdef ENABLE_READ_AHEAD
+  /* Read-ahead cache : the flash block following the last read */
+  uint8_t  ahead_buffer[JTAG2::DEFAULT_READ_SIZE];
+  uint32_t ahead_addr;      // address expected by the next request
+  uint16_t ahead_size;      // size expected by the next request, 0 : none
+  bool     ahead_valid;     // ahead_buffer holds ahead_addr and after
+
+  /* End of the flash window in the UPDI address space, 0 : unknown */
+  uint32_t flash_end (void) {
+    if (flash_size == 0) return 0;
+    uint32_t _base = NVM::version() != '0' ? 0x800000
+      : UPDI::signature[1] == 't' ? 0x8000 : 0x4000;
+    return _base + flash_size;
+  }
+  #endif
 
   bool check_pagesize (uint16_t seed, uint16_t test) {
     while (test != seed) {
@@ -61,8 +144,8 @@ bool NVM::read_memory (void) {
   DBG::print(" BC=", false); DBG::print_dec(byte_count);
   DBG::print(" SA=", false); DBG::print_hex(start_addr);
   #endif
-  /* Reads from 1 to 256 bytes and even bytes 258 to 512 are allowed */
-  if (byte_count == 0 || byte_count > 512 || (byte_count > 256 && byte_count & 1)) {
+  /* Reads from 1 to 256 bytes and even bytes 258 to frame_limit are allowed */
+  if (byte_count == 0 || byte_count > JTAG2::frame_limit || (byte_count > 256 && byte_count & 1)) {
     JTAG2::set_response(JTAG2::RSP_ILLEGAL_MEMORY_RANGE);
     return true;
   }
@@ -76,8 +159,11 @@ bool NVM::read_memory (void) {
     } while (--byte_count);
     return true;
   }
+  bool is_flash = mem_type == JTAG2::MTYPE_FLASH_PAGE
+    || mem_type == JTAG2::MTYPE_XMEGA_FLASH
+    || mem_type == JTAG2::MTYPE_BOOT_FLASH;
   if (byte_count >> 8)
-    return NVM::read_flash(start_addr, byte_count);
+    return NVM::read_flash(start_addr, byte_count, is_flash);
   else
     return NVM::read_data(start_addr, byte_count);
 }
@@ -127,21 +213,63 @@ bool NVM::write_memory (void) {
          The new AVRDUDE splits large page blocks into multiple queries to read-modify-write.
          This prevents atomic operations and requires special handling. */
       bool is_bound = !UPDI::is_control(UPDI::CHIP_ERASE);
+
+      #ifdef ENABLE_DIFFERENTIAL_WRITE
+      /* Only a whole page can be skipped, partial pages may need the erase.
+        A gang compares in GANG_STRICT : a secondary with another page
+        content would be dropped, so a gang always writes. */
+      if (is_bound && byte_count == flash_pagesize
+        && !UPDI::is_gang()
+        && mem_type != JTAG2::MTYPE_USERSIG
+        && NVM::compare_flash(start_addr, byte_count)) {
+        #ifdef ENABLE_STATISTICS
+        PROF::stats.same_skip++;
+        #endif
+        #ifdef DEBUG_USE_USART
+        DBG::print("[SAME]", false);
+        #endif
+        return true;
+      }
+      #endif
+
       if (is_bound) {
         uint32_t block_addr = start_addr & ~(flash_pagesize - 1);
-        is_bound = before_addr != block_addr;
+        is_bound = before_addr != block_addr && erase_plan(block_addr);
         before_addr = block_addr;
       }
 
+      /* An all $FF page needs no write on a chip erased device */
+      else if (JTAG2::body_blank && mem_type != JTAG2::MTYPE_USERSIG) {
+        #ifdef ENABLE_STATISTICS
+        PROF::stats.blank_skip++;
+        #endif
+        #ifdef DEBUG_USE_USART
+        DBG::print("[SKIP]", false);
+        #endif
+        return true;
+      }
+
+      #ifdef ENABLE_POSTED_WRITE
+      /* The request is valid, so the host can send the next page now. */
+      /* Once only : a WRITE_RETRY second attempt must not answer again */
+      /* Not while recording : self programming needs a quiet host */
+      if (JTAG2::is_control(JTAG2::HOST_SIGN_ON)
+        && !JTAG2::is_control(JTAG2::ANS_POSTED)
+        && !STORE::is_recording()
+        && byte_count <= JTAG2::MAX_POSTED_SIZE) JTAG2::answer_posted();
+      #endif
+
       /* NVMCTRL processing steps vary depending on the version. */
-      if (UPDI::NVMPROGVER == '0')
+      uint8_t _ver = NVM::version();
+      if (is_built('0') && _ver == '0')
         return NVM::write_flash(start_addr, byte_count, is_bound);
-      else if (UPDI::NVMPROGVER == '4')
+      else if (is_built('4') && _ver == '4')
         return NVM::write_flash_v4(start_addr, byte_count, is_bound);
-      else if (UPDI::NVMPROGVER == '2')
+      else if (is_built('2') && _ver == '2')
         return NVM::write_flash_v2(start_addr, byte_count, is_bound);
-      else
+      else if ((is_built('3') && _ver == '3') || (is_built('5') && _ver == '5'))
         return NVM::write_flash_v3(start_addr, byte_count, is_bound);
+      return false;
     }
   }
 
@@ -155,12 +283,14 @@ bool NVM::write_memory (void) {
   switch (mem_type) {
     case JTAG2::MTYPE_SRAM :
     {
+      /* The host may write the NVMCTRL registers directly */
+      UPDI::NVMCMD_SHADOW = -1;
       write_data(start_addr, byte_count);
       return true;
     }
     case JTAG2::MTYPE_LOCK_BITS :
     case JTAG2::MTYPE_FUSE_BITS :
-      if (UPDI::NVMPROGVER == '0') {
+      if (NVM::version() == '0') {
         uint8_t *p = &JTAG2::packet.body[10];
         do {
           if (!NVM::write_fuse(start_addr++, *p++)) return false;
@@ -170,21 +300,118 @@ bool NVM::write_memory (void) {
   }
 
   /* NVMCTRL processing steps vary depending on the version. */
-  if (UPDI::NVMPROGVER == '0')
+  uint8_t _ver = NVM::version();
+  if (is_built('0') && _ver == '0')
     return NVM::write_eeprom(start_addr, byte_count);
-  else if (UPDI::NVMPROGVER == '4')
+  else if (is_built('4') && _ver == '4')
     return NVM::write_eeprom_v4(start_addr, byte_count);
-  else if (UPDI::NVMPROGVER == '2')
+  else if (is_built('2') && _ver == '2')
     return NVM::write_eeprom_v2(start_addr, byte_count);
-  else
+  else if ((is_built('3') && _ver == '3') || (is_built('5') && _ver == '5'))
     return NVM::write_eeprom_v3(start_addr, byte_count);
+  return false;
 }
 
-bool NVM::read_flash (uint32_t start_addr, size_t byte_count) {
+/* Word reads of any memory : is_flash allows read-ahead and streaming */
+bool NVM::read_flash (uint32_t start_addr, size_t byte_count, bool is_flash) {
   uint8_t* p = &JTAG2::packet.body[1];
   #ifdef DEBUG_DUMP_MEMORY
   size_t count = byte_count;
   #endif
+  #ifdef ENABLE_READ_AHEAD
+  bool _hit = is_flash && NVM::ahead_valid
+    && NVM::ahead_addr == start_addr && NVM::ahead_size == byte_count;
+  NVM::ahead_valid = false;
+  NVM::ahead_addr = start_addr + byte_count;
+  /* Only a next block that still lies inside the flash is loaded */
+  NVM::ahead_size = is_flash
+    && byte_count <= sizeof(NVM::ahead_buffer)
+    && NVM::ahead_addr + byte_count <= flash_end() ? byte_count : 0;
+  if (_hit) {
+    memcpy(p, NVM::ahead_buffer, byte_count);
+    #ifdef DEBUG_USE_USART
+    DBG::print("[HIT]", false);
+    #endif
+    return true;
+  }
+  #endif
+  byte_count >>= 1;
+  if (byte_count == 0 || byte_count > (JTAG2::MAX_READ_SIZE >> 1)) return false;
+  #ifdef ENABLE_STREAM_READ
+  /* The header goes out before LD : UPDI data must not wait behind it */
+  bool _stream = is_flash && JTAG2::stream_ready();
+  if (_stream) JTAG2::stream_begin(JTAG2::RSP_MEMORY, JTAG2::packet.size_word[0]);
+  #endif
+  /* One REPEAT transfers at most 256 words : larger frames take several */
+  do {
+    size_t _words = byte_count > 256 ? 256 : byte_count;
+    byte_count -= _words;
+    if (!UPDI::send_repeat_header(
+      (UPDI::UPDI_LD | UPDI::UPDI_DATA2),
+      start_addr,
+      _words
+    )) return false;
+    start_addr += _words << 1;
+    #ifdef ENABLE_STREAM_READ
+    if (_stream) {
+      do {
+        JTAG2::stream_put(*p++ = UPDI::RECV());
+        JTAG2::stream_put(*p++ = UPDI::RECV());
+      } while (--_words);
+    }
+    else
+    #endif
+    do {
+      *p++ = UPDI::RECV();
+      *p++ = UPDI::RECV();
+    } while (--_words);
+  } while (byte_count);
+  #ifdef ENABLE_STREAM_READ
+  if (_stream) JTAG2::stream_end();
+  #endif
+  #ifdef DEBUG_DUMP_MEMORY
+  DBG::print("[RD]", false);
+  DBG::dump(&JTAG2::packet.body[1], count);
+  #endif
+  return true;
+}
+
+#ifdef ENABLE_READ_AHEAD
+/* Load the block a sequential reader asks for next into ahead_buffer */
+bool NVM::read_ahead (void) {
+  uint8_t* p = &NVM::ahead_buffer[0];
+  uint32_t _addr = NVM::ahead_addr;
+  size_t _words = NVM::ahead_size >> 1;
+  if (_words == 0 || !UPDI::is_control(UPDI::ENABLE_NVMPG)) return true;
+  /* One REPEAT transfers at most 256 words */
+  do {
+    size_t _count = _words > 256 ? 256 : _words;
+    _words -= _count;
+    if (!UPDI::send_repeat_header(
+      (UPDI::UPDI_LD | UPDI::UPDI_DATA2),
+      _addr,
+      _count
+    )) return false;
+    _addr += _count << 1;
+    do {
+      *p++ = UPDI::RECV();
+      *p++ = UPDI::RECV();
+    } while (--_count);
+  } while (_words);
+  NVM::ahead_valid = true;
+  return true;
+}
+
+void NVM::read_ahead_clear (void) {
+  NVM::ahead_valid = false;
+  NVM::ahead_size = 0;
+}
+#endif
+
+/* true : The target flash already holds the received page data */
+bool NVM::compare_flash (uint32_t start_addr, size_t byte_count) {
+  uint8_t* p = &JTAG2::packet.body[10];
+  bool _same = true;
   byte_count >>= 1;
   if (byte_count == 0 || byte_count > 256) return false;
   if (!UPDI::send_repeat_header(
@@ -192,15 +419,12 @@ bool NVM::read_flash (uint32_t start_addr, size_t byte_count) {
     start_addr,
     byte_count
   )) return false;
+  /* the repeat must be received to the end even after a difference */
   do {
-    *p++ = UPDI::RECV();
-    *p++ = UPDI::RECV();
+    if (*p++ != UPDI::RECV()) _same = false;
+    if (*p++ != UPDI::RECV()) _same = false;
   } while (--byte_count);
-  #ifdef DEBUG_DUMP_MEMORY
-  DBG::print("[RD]", false);
-  DBG::dump(&JTAG2::packet.body[1], count);
-  #endif
-  return true;
+  return _same;
 }
 
 bool NVM::read_data (uint32_t start_addr, size_t byte_count) {
@@ -209,9 +433,20 @@ bool NVM::read_data (uint32_t start_addr, size_t byte_count) {
   size_t count = byte_count;
   #endif
   if (byte_count == 0 || byte_count > 256) return false;
+  #ifdef ENABLE_STREAM_READ
+  bool _stream = JTAG2::stream_ready();
+  if (_stream) JTAG2::stream_begin(JTAG2::RSP_MEMORY, byte_count + 1);
+  #endif
   if (!UPDI::send_repeat_header(
     (UPDI::UPDI_LD | UPDI::UPDI_DATA1),
     start_addr, byte_count)) return false;
+  #ifdef ENABLE_STREAM_READ
+  if (_stream) {
+    do { JTAG2::stream_put(*p++ = UPDI::RECV()); } while (--byte_count);
+    JTAG2::stream_end();
+  }
+  else
+  #endif
   do { *p++ = UPDI::RECV(); } while (--byte_count);
   #ifdef DEBUG_USE_USART
   if (count <= 8) {
@@ -226,27 +461,88 @@ bool NVM::read_data (uint32_t start_addr, size_t byte_count) {
   return true;
 }
 
+/* Remember when a timed NVMCTRL operation was started */
+void NVM::nvm_issue (uint8_t nvmcmd) {
+  if (NVM::wait_version != UPDI::NVMPROGVER) {
+    /* Another device family : forget the learned times */
+    NVM::wait_version = UPDI::NVMPROGVER;
+    memset(NVM::wait_learned, 0, sizeof(NVM::wait_learned));
+  }
+  NVM::wait_class = wait_class_of(nvmcmd);
+  NVM::wait_issued = TIMER::micros();
+}
+
+/* An operation left running by the previous request is not timed */
+void NVM::nvm_wait_cancel (void) {
+  NVM::wait_class = NVM::WAIT_NONE;
+}
+
+/* Sleep for most of the expected time, then poll with a short LDS */
+uint8_t NVM::nvm_wait_status (uint16_t status_reg) {
+  #ifdef ENABLE_PROFILE
+  uint32_t _prof = PROF::start();
+  #endif
+  #ifdef ENABLE_STATISTICS
+  uint16_t _stat = TIMER::micros();
+  #endif
+  uint8_t _class = NVM::wait_class;
+  if (_class != NVM::WAIT_NONE) {
+    uint16_t &_learned = NVM::wait_learned[_class];
+    if (_learned == 0) {
+      _learned = NVM::wait_seed[wait_family()][_class];
+    }
+    uint16_t _expect = _learned - (_learned >> 2);
+    while ((uint16_t)(TIMER::micros() - NVM::wait_issued) < _expect);
+  }
+  UPDI::gang_merge(UPDI::GANG_OR);
+  while (UPDI::ld8_a16(status_reg) & 3);
+  UPDI::gang_merge(UPDI::GANG_STRICT);
+  if (_class != NVM::WAIT_NONE) {
+    /* self tuning : moving average of the observed completion time */
+    uint16_t _span = TIMER::micros() - NVM::wait_issued;
+    if (_span <= NVM::wait_limit[wait_family()][_class]) {
+      uint16_t &_learned = NVM::wait_learned[_class];
+      _learned = _learned - (_learned >> 2) + (_span >> 2);
+    }
+    NVM::wait_class = NVM::WAIT_NONE;
+  }
+  #ifdef ENABLE_PROFILE
+  PROF::stop(PROF::PROF_NVM_WAIT, _prof);
+  #endif
+  #ifdef ENABLE_STATISTICS
+  PROF::stats.nvm_wait_us += (uint16_t)(TIMER::micros() - _stat);
+  #endif
+  return UPDI::LASTL;
+}
+
 /* NVMCTRL v0 */
 /* NVMCTRL v2 */
 uint8_t NVM::nvm_wait (void) {
-  while (UPDI::ld8(NVM::NVMCTRL_REG_STATUS) & 3);
-  return UPDI::LASTL;
+  return NVM::nvm_wait_status(NVM::NVMCTRL_REG_STATUS);
 }
 
 /* NVMCTRL v3 */
 uint8_t NVM::nvm_wait_v3 (void) {
-  while (UPDI::ld8(NVM::NVMCTRL_V3_REG_STATUS) & 3);
-  return UPDI::LASTL;
+  return NVM::nvm_wait_status(NVM::NVMCTRL_V3_REG_STATUS);
 }
 
 /* NVMCTRL v0 */
 bool NVM::nvm_ctrl (uint8_t nvmcmd) {
-  return UPDI::st8(NVM::NVMCTRL_REG_CTRLA, nvmcmd);
+  UPDI::NVMCMD_SHADOW = -1;
+  if (!UPDI::st8(NVM::NVMCTRL_REG_CTRLA, nvmcmd)) return false;
+  /* NVMCTRL v2 and later hold the command until it is changed */
+  if (NVM::version() != '0') UPDI::NVMCMD_SHADOW = nvmcmd;
+  NVM::nvm_issue(nvmcmd);
+  return true;
 }
 
 bool nvm_ctrl_change (uint8_t nvmcmd) {
-  if (UPDI::ld8(NVM::NVMCTRL_REG_CTRLA) == nvmcmd) return true;
-  if (!NVM::nvm_ctrl(NVM::NVM_V2_CMD_NOCMD)) return false;
+  uint8_t _now = UPDI::NVMCMD_SHADOW >= 0
+    ? UPDI::NVMCMD_SHADOW
+    : UPDI::ld8(NVM::NVMCTRL_REG_CTRLA);
+  if (_now == nvmcmd) return true;
+  if (_now != NVM::NVM_V2_CMD_NOCMD
+    && !NVM::nvm_ctrl(NVM::NVM_V2_CMD_NOCMD)) return false;
   if (NVM::NVM_V2_CMD_NOCMD != nvmcmd) return NVM::nvm_ctrl(nvmcmd);
   return true;
 }
@@ -280,45 +576,23 @@ bool NVM::write_fuse (uint16_t addr, uint8_t data) {
 }
 
 bool NVM::write_data (uint32_t start_addr, size_t byte_count) {
-  /* setting register pointer */
-  *((uint32_t*)&set_ptr[2]) = start_addr;
-  set_repeat[2] = (uint8_t)byte_count - 1;
-  if (!UPDI::send_bytes(set_ptr, sizeof(set_ptr) - 1)) return false;
-  if (UPDI::UPDI_ACK != UPDI::RECV()) return false;
-  if (!UPDI::send_bytes(set_repeat, sizeof(set_repeat))) return false;
-  /* page buffer stored */
-  uint8_t* p = &JTAG2::packet.body[10];
-  do {
-    if (!UPDI::SEND(*p++)) return false;
-    if (UPDI::UPDI_ACK != UPDI::RECV()) return false;
-  } while (--byte_count);
-  return true;
+  return UPDI::sts_burst(start_addr, &JTAG2::packet.body[10], byte_count);
 }
 
 bool NVM::write_data_word (uint32_t start_addr, size_t byte_count) {
-  byte_count >>= 1;
-
-  /* setting register pointer and enable RSD mode */
-  *((uint32_t*)&set_ptr[2]) = start_addr;
-  set_repeat_rsd[5] = (uint8_t)byte_count - 1;
-  if (!UPDI::send_bytes(set_ptr, sizeof(set_ptr) - 1)) return false;
-  if (UPDI::UPDI_ACK != UPDI::RECV()) return false;
-  if (!UPDI::send_bytes(set_repeat_rsd, sizeof(set_repeat_rsd))) return false;
-
-  /* page buffer stored */
-  uint8_t* p = &JTAG2::packet.body[10];
-  do {
-    UPDI::SEND(*p++);
-    UPDI::SEND(*p++);
-  } while (--byte_count);
-
-  /* disable RSD mode */
-  return UPDI::set_cs_ctra(UPDI::UPDI_SET_GTVAL_2);
+  #ifdef ENABLE_PROFILE
+  uint32_t _prof = PROF::start();
+  bool _result = UPDI::sts_burst(start_addr, &JTAG2::packet.body[10], byte_count, true);
+  PROF::stop(PROF::PROF_PAGE_STORE, _prof);
+  return _result;
+  #else
+  return UPDI::sts_burst(start_addr, &JTAG2::packet.body[10], byte_count, true);
+  #endif
 }
 
 /* NVMCTRL v0 */
 bool NVM::write_eeprom (uint32_t start_addr, size_t byte_count) {
-  if (byte_count > 64) {
+  if (byte_count > 256) {
     JTAG2::set_response(JTAG2::RSP_ILLEGAL_MEMORY_RANGE);
     return true;
   }
@@ -327,21 +601,47 @@ bool NVM::write_eeprom (uint32_t start_addr, size_t byte_count) {
   DBG::dump(start_addr, byte_count);
   #endif
 
-  /* NVMCTRL page buffer clear */
-  // NVM::nvm_wait();
-  // if (!NVM::nvm_ctrl(NVM::NVM_CMD_PBC)) return false;
-  NVM::nvm_wait();
-
-  if (!write_data(start_addr, byte_count)) return false;
+  /* The page buffer wraps at the EEPROM page : one ERWP per page */
+  uint8_t _page = NVM::eeprom_pagesize ? NVM::eeprom_pagesize : 32;
+  uint8_t *p = &JTAG2::packet.body[10];
+  do {
+    size_t _count = _page - (start_addr & (_page - 1));
+    if (_count > byte_count) _count = byte_count;
 
-  /* NVMCTRL write page and complete */
-  if (!NVM::nvm_ctrl(NVM::NVM_CMD_ERWP)) return false;
+    NVM::nvm_wait();
+    if (!UPDI::sts_burst(start_addr, p, _count)) return false;
+
+    /* NVMCTRL write page and complete */
+    if (!NVM::nvm_ctrl(NVM::NVM_CMD_ERWP)) return false;
+    ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+    start_addr += _count;
+    p += _count;
+    byte_count -= _count;
+  } while (byte_count);
   return NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_NOCMD);
 }
 
+/* NVMCTRL v2,4 : EEERWR erases and writes each stored byte pair */
+bool write_eeprom_erwr (uint32_t start_addr, size_t byte_count, uint16_t status_reg) {
+  uint8_t *p = &JTAG2::packet.body[10];
+  /* One JTAG2 request, one command change, a busy wait between pairs */
+  for (;;) {
+    size_t _count = byte_count < 2 ? byte_count : 2;
+    if (!UPDI::sts_burst(start_addr, p, _count)) return false;
+    NVM::nvm_issue(NVM::NVM_V2_CMD_EEERWR);
+    start_addr += _count;
+    p += _count;
+    if ((byte_count -= _count) == 0) break;
+    NVM::nvm_wait_status(status_reg);
+    /* 128 pairs of about 10ms each outlast one UPDI_ABORT_MS */
+    ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+  }
+  return ((NVM::nvm_wait_status(status_reg) & 3) == 0);
+}
+
 /* NVMCTRL v2 */
 bool NVM::write_eeprom_v2 (uint32_t start_addr, size_t byte_count) {
-  if (byte_count > 2) {
+  if (byte_count > 256) {
     JTAG2::set_response(JTAG2::RSP_ILLEGAL_MEMORY_RANGE);
     return true;
   }
@@ -353,14 +653,12 @@ bool NVM::write_eeprom_v2 (uint32_t start_addr, size_t byte_count) {
   NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_NOCMD);
   if (!NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_EEERWR)) return false;
 
-  if (!write_data(start_addr, byte_count)) return false;
-
-  return ((NVM::nvm_wait() & 3) == 0);
+  return write_eeprom_erwr(start_addr, byte_count, NVM::NVMCTRL_REG_STATUS);
 }
 
 /* NVMCTRL v3 */
 bool NVM::write_eeprom_v3 (uint32_t start_addr, size_t byte_count) {
-  if (byte_count > 8) {
+  if (byte_count > 256) {
     JTAG2::set_response(JTAG2::RSP_ILLEGAL_MEMORY_RANGE);
     return true;
   }
@@ -369,16 +667,28 @@ bool NVM::write_eeprom_v3 (uint32_t start_addr, size_t byte_count) {
   DBG::dump(start_addr, byte_count);
   #endif
 
-  if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_EEPBCLR)) return false;
+  /* The EEPROM page buffer holds 8 bytes : one erase/write per page */
+  uint8_t *p = &JTAG2::packet.body[10];
+  do {
+    size_t _count = 8 - (start_addr & 7);
+    if (_count > byte_count) _count = byte_count;
+
+    if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_EEPBCLR)) return false;
 
-  if (!write_data(start_addr, byte_count)) return false;
+    if (!UPDI::sts_burst(start_addr, p, _count)) return false;
 
-  return NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_EEPERW);
+    if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_EEPERW)) return false;
+    ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+    start_addr += _count;
+    p += _count;
+    byte_count -= _count;
+  } while (byte_count);
+  return true;
 }
 
 /* NVMCTRL v4 */
 bool NVM::write_eeprom_v4 (uint32_t start_addr, size_t byte_count) {
-  if (byte_count > 2) {
+  if (byte_count > 256) {
     JTAG2::set_response(JTAG2::RSP_ILLEGAL_MEMORY_RANGE);
     return true;
   }
@@ -390,9 +700,7 @@ bool NVM::write_eeprom_v4 (uint32_t start_addr, size_t byte_count) {
   NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_NOCMD);
   if (!NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_EEERWR)) return false;
 
-  if (!write_data(start_addr, byte_count)) return false;
-
-  return ((NVM::nvm_wait_v3() & 3) == 0);
+  return write_eeprom_erwr(start_addr, byte_count, NVM::NVMCTRL_V3_REG_STATUS);
 }
 
 /* NVMCTRL v0 */
@@ -428,7 +736,7 @@ bool NVM::write_flash_v2 (uint32_t start_addr, size_t byte_count, bool is_bound)
   /* However, only when the beginning of the page boundary is addressed */
   NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_NOCMD);
   if (is_bound) {
-    if (!NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_FLPER)) return false;
+    if (!NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_FLPER + NVM::erase_order)) return false;
     if (!UPDI::st8(start_addr, 0xFF)) return false;
   }
   if (!NVM::nvm_ctrl_v2(NVM::NVM_V2_CMD_FLWR)) return false;
@@ -450,7 +758,7 @@ bool NVM::write_flash_v3 (uint32_t start_addr, size_t byte_count, bool is_bound)
   if (is_bound) {
     NVM::nvm_wait_v3();
     if (!UPDI::st8(start_addr, 0xFF)) return false;
-    if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_FLPER)) return false;
+    if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_FLPER + NVM::erase_order)) return false;
   }
   if (!NVM::nvm_ctrl_v3(NVM::NVM_V3_CMD_FLPBCLR)) return false;
 
@@ -470,7 +778,7 @@ bool NVM::write_flash_v4 (uint32_t start_addr, size_t byte_count, bool is_bound)
   /* However, only when the beginning of the page boundary is addressed */
   NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_NOCMD);
   if (is_bound) {
-    if (!NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_FLPER)) return false;
+    if (!NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_FLPER + NVM::erase_order)) return false;
     if (!UPDI::st8(start_addr, 0xFF)) return false;
   }
   if (!NVM::nvm_ctrl_v3(NVM::NVM_V2_CMD_FLWR)) return false;
@@ -482,14 +790,18 @@ bool NVM::write_flash_v4 (uint32_t start_addr, size_t byte_count, bool is_bound)
 
 bool NVM::chip_erase (void) {
   /* NVMCTRL processing steps vary depending on the version. */
-  if (UPDI::NVMPROGVER == '0') {
+  uint8_t _ver = NVM::version();
+  /* A single built in version is a constant : the connected device
+    must still report it, and 0 means an unknown or unbuilt NVMCTRL */
+  if (UPDI::NVMPROGVER == 0 || UPDI::NVMPROGVER != _ver) return false;
+  if (_ver == '0') {
     /* version 0 */
     if (!nvm_ctrl_v2(NVM_CMD_CHER)) return false;
     if (!nvm_ctrl_v2(NVM_CMD_PBC)) return false;
     if (!nvm_ctrl_v2(NVM_CMD_NOOP)) return false;
     nvm_wait();
   }
-  else if (UPDI::NVMPROGVER == '2') {
+  else if (_ver == '2') {
     /* version 2 */
     if (!nvm_ctrl_v2(NVM_V2_CMD_CHER)) return false;
     if (!nvm_ctrl_v2(NVM_V2_CMD_NOCMD)) return false;
@@ -500,7 +812,7 @@ bool NVM::chip_erase (void) {
     if (!nvm_ctrl_v3(NVM_V2_CMD_CHER)) return false;
     if (!nvm_ctrl_v3(NVM_V2_CMD_NOCMD)) return false;
     nvm_wait_v3();
-    if (UPDI::NVMPROGVER != '4') {
+    if (_ver != '4') {
       if (!nvm_ctrl_v3(NVM_V3_CMD_FLPBCLR)) return false;
       if (!nvm_ctrl_v3(NVM_V2_CMD_NOCMD)) return false;
       if (!nvm_ctrl_v3(NVM_V3_CMD_EEPBCLR)) return false;
@@ -12,8 +12,34 @@
 #include <string.h>
 #include <setjmp.h>
 #include "../configuration.h"
+#include "UPDI.h"
+
+/* NVMCTRL version build selection */
+#define NVMCTRL_V0 (1 << 0)   /* megaAVR-0, tinyAVR-0,1,2 */
+#define NVMCTRL_V2 (1 << 2)   /* AVR_DA, AVR_DB, AVR_DD */
+#define NVMCTRL_V3 (1 << 3)   /* AVR_EA */
+#define NVMCTRL_V4 (1 << 4)   /* AVR_DU */
+#define NVMCTRL_V5 (1 << 5)   /* AVR_EB */
+#ifndef NVMCTRL_VERSIONS
+  #define NVMCTRL_VERSIONS (NVMCTRL_V0 | NVMCTRL_V2 | NVMCTRL_V3 | NVMCTRL_V4 | NVMCTRL_V5)
+#endif
 
 namespace NVM {
+  /* true : The driver for NVMPROGVER '0' to '5' is built in */
+  constexpr bool is_built (uint8_t ver) {
+    return ver >= '0' && ver <= '5' && ((NVMCTRL_VERSIONS >> (ver - '0')) & 1);
+  }
+  /* The version character when only one driver is built in, otherwise 0 */
+  constexpr uint8_t only_version (uint8_t ver = '0') {
+    return ver > '5' ? 0
+      : NVMCTRL_VERSIONS == (1 << (ver - '0')) ? ver
+      : only_version(ver + 1);
+  }
+  /* A single built in version is a constant and folds the dispatch away */
+  inline uint8_t version (void) {
+    return only_version() ? only_version() : UPDI::NVMPROGVER;
+  }
+
   /* NVMCTRL v0,2 */
   enum nvm_register_v02_e {
       NVMCTRL_REG_CTRLA    = 0x1000
@@ -101,6 +127,14 @@ namespace NVM {
     , NVM_V3_CMD_CHER       = 0x20  /* NVM_V2_CMD_CHER */
     , NVM_V3_CMD_EECHER     = 0x30  /* NVM_V2_CMD_EECHER */
   };
+  /* Adaptive busy wait : operation classes */
+  enum nvm_wait_class_e {
+      WAIT_NONE
+    , WAIT_ERASE
+    , WAIT_WRITE
+    , WAIT_EEPROM
+    , WAIT_CLASSES
+  };
   enum avr_base_addr_e {
       BASE_NVMCTRL = 0x1000
     , BASE_FUSE    = 0x1050
@@ -117,14 +151,23 @@ namespace NVM {
   };
 
   extern uint16_t flash_pagesize;
+  extern uint32_t flash_size;
+  extern uint8_t eeprom_pagesize;
+  extern uint8_t erase_order;
   bool read_memory (void);
   bool write_memory (void);
   bool write_data (uint32_t start_addr, size_t byte_count);
   bool write_data_word (uint32_t start_addr, size_t byte_count);
 
   bool read_data (uint32_t start_addr, size_t byte_count);
-  bool read_flash (uint32_t start_addr, size_t byte_count);
+  bool read_flash (uint32_t start_addr, size_t byte_count, bool is_flash);
+  bool compare_flash (uint32_t start_addr, size_t byte_count);
+  bool read_ahead (void);
+  void read_ahead_clear (void);
 
+  void nvm_issue (uint8_t nvmcmd);
+  void nvm_wait_cancel (void);
+  uint8_t nvm_wait_status (uint16_t status_reg);
   uint8_t nvm_wait (void);
   bool nvm_ctrl (uint8_t nvmcmd);
   bool write_fuse (uint16_t addr, uint8_t data);
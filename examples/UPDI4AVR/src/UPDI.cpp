@@ -16,6 +16,7 @@
 #include "usart.h"
 #include "timer.h"
 #include "abort.h"
+#include "prof.h"
 #include "dbg.h"
 
 namespace UPDI {
@@ -26,8 +27,75 @@ namespace UPDI {
   volatile uint8_t LASTL; // Last read byte
   volatile uint8_t LASTH; // Last read status
   uint8_t NVMPROGVER;
+  uint32_t BAUDRATE;
+  uint32_t PTR_SHADOW = ~0;   // target PTR after the last transfer
+  int16_t NVMCMD_SHADOW = -1; // target NVMCTRL.CTRLA, -1 : unknown
+  #ifdef ENABLE_WARM_ENTRY
+  bool NVMPROG_HELD;          // the target was left in NVMPROG
+  #endif
   uint8_t CONTROL;
   uint8_t signature[4];
+  #ifdef UPDI_HIGH_BAUDRATE
+  /* Rate negotiated with the last target : the next ENTER of the same */
+  /* signature starts its probe there, a slow target is not probed again */
+  uint8_t SPEED_SIGNATURE[3];
+  uint32_t SPEED_BAUDRATE;
+  #endif
+
+  #ifdef UPDI_GANG_MODULES
+  /* Gang programming : secondary targets follow the primary in lock-step */
+  const gang_module_t GANG[] = { UPDI_GANG_MODULES };
+  constexpr uint8_t GANG_COUNT = sizeof(GANG) / sizeof(GANG[0]);
+  constexpr uint8_t GANG_ALL = (1 << GANG_COUNT) - 1;
+  uint8_t GANG_ACTIVE;    // bit n : GANG[n] is still in lock-step
+  uint8_t GANG_MERGE;     // UPDI::gang_merge_e
+  uint16_t GANG_WAIT_US;  // a secondary answer later than this is lost
+
+  inline void gang_baud (uint16_t baud_reg) {
+    for (uint8_t i = 0; i < GANG_COUNT; i++) GANG[i].module->BAUD = baud_reg;
+  }
+  inline void gang_write (uint8_t data) {
+    for (uint8_t i = 0; i < GANG_COUNT; i++) {
+      if (GANG_ACTIVE & _BV(i)) USART::write(GANG[i].module, data);
+    }
+  }
+  inline void gang_wait_tx (void) {
+    for (uint8_t i = 0; i < GANG_COUNT; i++) {
+      if (GANG_ACTIVE & _BV(i)) while (!USART::is_tx_complete(GANG[i].module));
+    }
+  }
+  inline void gang_drain (void) {
+    for (uint8_t i = 0; i < GANG_COUNT; i++) {
+      while (USART::is_rx_ready(GANG[i].module)) {
+        USART::read_status(GANG[i].module);
+        USART::read(GANG[i].module);
+      }
+    }
+  }
+  /* Check or merge each secondary answer against the primary one */
+  uint8_t gang_recv (uint8_t data) {
+    uint8_t _or = data, _and = data;
+    for (uint8_t i = 0; i < GANG_COUNT; i++) {
+      if (!(GANG_ACTIVE & _BV(i))) continue;
+      uint16_t _start = TIMER::micros();
+      while (!USART::is_rx_ready(GANG[i].module)) {
+        if ((uint16_t)(TIMER::micros() - _start) > GANG_WAIT_US) break;
+      }
+      if (!USART::is_rx_ready(GANG[i].module)) {
+        GANG_ACTIVE &= ~_BV(i);
+        continue;
+      }
+      uint8_t _status = USART::read_status(GANG[i].module) ^ 0x80;
+      uint8_t _data = USART::read(GANG[i].module);
+      _or |= _data; _and &= _data;
+      if ((_status & (USART_PERR_bm | USART_FERR_bm | USART_BUFOVF_bm))
+        || (GANG_MERGE == GANG_STRICT && _data != data)) {
+        GANG_ACTIVE &= ~_BV(i);
+      }
+    }
+    return GANG_MERGE == GANG_OR ? _or : GANG_MERGE == GANG_AND ? _and : data;
+  }
+  #endif
 }
 
 void UPDI::setup (void) {
@@ -57,10 +125,47 @@ void UPDI::setup (void) {
     (USART_TXEN_bm | USART_RXEN_bm | USART_ODME_bm | USART_RXMODE_NORMAL_gc),
     (USART_CHSIZE_8BIT_gc | USART_PMODE_EVEN_gc | USART_CMODE_ASYNCHRONOUS_gc | USART_SBMODE_2BIT_gc)
   );
+  UPDI::BAUDRATE = UPDI_USART_BAUDRATE;
+
+  #ifdef UPDI_GANG_MODULES
+  /* each secondary : its own route register and TDAT pin, as the primary */
+  for (uint8_t i = 0; i < GANG_COUNT; i++) {
+    *GANG[i].route |= GANG[i].route_gc;
+    *GANG[i].tdat_ctrl =
+      #ifdef UPDI_TDAT_PIN_PULLUP
+      PORT_PULLUPEN_bm |
+      #endif
+      PORT_ISC_INTDISABLE_gc;
+    USART::setup(
+      GANG[i].module,
+      USART::calc_baudrate(UPDI_USART_BAUDRATE),
+      (USART_LBME_bm | 0x03),
+      (USART_TXEN_bm | USART_RXEN_bm | USART_ODME_bm | USART_RXMODE_NORMAL_gc),
+      (USART_CHSIZE_8BIT_gc | USART_PMODE_EVEN_gc | USART_CMODE_ASYNCHRONOUS_gc | USART_SBMODE_2BIT_gc)
+    );
+  }
+  UPDI::gang_restore();
+  UPDI::GANG_WAIT_US = 24000000L / UPDI_USART_BAUDRATE + 1;
+  #endif
 }
 
+#ifdef UPDI_GANG_MODULES
+/* Take every secondary target back into the gang */
+void UPDI::gang_restore (void) {
+  UPDI::GANG_ACTIVE = GANG_ALL;
+}
+#endif
+
 void UPDI::fallback_speed (uint32_t baudrate) {
+  UPDI::BAUDRATE = baudrate;
   USART::change_baudrate(&UPDI_USART_MODULE, USART::calc_baudrate(baudrate));
+  #ifdef UPDI_GANG_MODULES
+  /* the same BAUD and CLK2X for every secondary, two symbols of skew */
+  for (uint8_t i = 0; i < GANG_COUNT; i++) {
+    USART::change_baudrate(GANG[i].module, USART::calc_baudrate(baudrate));
+  }
+  UPDI::GANG_WAIT_US = 24000000L / baudrate + 1;
+  #endif
   #ifdef DEBUG_USE_USART
   DBG::print("UBAUD=");
   DBG::print_dec(UPDI_USART_MODULE.BAUD);
@@ -69,21 +174,87 @@ void UPDI::fallback_speed (uint32_t baudrate) {
   #endif
 }
 
+/* Raise the target UPDI clock, then step up to the fastest verified rate */
+bool UPDI::speed_up (void) {
+  #ifdef UPDI_HIGH_BAUDRATE
+  if (UPDI::is_control(UPDI::UPDI_LOWBAUD)) return false;
+  uint32_t baudrate = UPDI_HIGH_BAUDRATE;
+  if (memcmp(UPDI::SPEED_SIGNATURE, UPDI::signature, 3) == 0) {
+    baudrate = UPDI::SPEED_BAUDRATE;
+  }
+  else {
+    memcpy(UPDI::SPEED_SIGNATURE, UPDI::signature, 3);
+  }
+  for (; baudrate > UPDI_USART_BAUDRATE; baudrate >>= 1) {
+    uint8_t clksel =
+        baudrate > 900000L ? UPDI::UPDI_SET_UPDICLKSEL_32M
+      : baudrate > 450000L ? UPDI::UPDI_SET_UPDICLKSEL_16M
+      : baudrate > 225000L ? UPDI::UPDI_SET_UPDICLKSEL_8M
+      :                      UPDI::UPDI_SET_UPDICLKSEL_4M;
+    /* UPDI follows any lower rate by SYNCH, so the change is made at the base rate */
+    UPDI::fallback_speed(UPDI_USART_BAUDRATE);
+    if (!UPDI::set_cs_stat(UPDI::UPDI_CS_ASI_CTRLA, clksel)) break;
+    UPDI::fallback_speed(baudrate);
+    /* loopback, parity and readback check : a target that cannot follow stays silent */
+    volatile bool _ok = false;
+    jmp_buf _probe;
+    if (setjmp(_probe) == 0) {
+      ABORT::start_timer(_probe, 20);
+      _ok = (UPDI::ldcs(UPDI::UPDI_CS_ASI_CTRLA) & UPDI::UPDI_SET_UPDICLKSEL_bm) == clksel
+        && UPDI::LASTH == 0;
+    }
+    ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+    if (_ok) {
+      #ifdef DEBUG_USE_USART
+      DBG::print("[HS]", false);
+      #endif
+      UPDI::SPEED_BAUDRATE = baudrate;
+      return true;
+    }
+    UPDI::fallback_speed(UPDI_USART_BAUDRATE);
+    UPDI::BREAK();
+    /* read away the error signature the failed step left in STATUSB */
+    UPDI::ldcs(UPDI::UPDI_CS_STATUSB);
+  }
+  UPDI::fallback_speed(UPDI_USART_BAUDRATE);
+  UPDI::set_control(UPDI::UPDI_LOWBAUD);
+  UPDI::SPEED_BAUDRATE = UPDI_USART_BAUDRATE;
+  #endif
+  return false;
+}
+
 void UPDI::drain (void) {
   uint8_t j = 0;
   do {
-    if (bit_is_set(UPDI_USART_MODULE.STATUS, USART_RXCIF_bp)) {
-      UPDI::LASTH = UPDI_USART_MODULE.RXDATAH;
-      UPDI::LASTL = UPDI_USART_MODULE.RXDATAL;
+    if (USART::is_rx_ready(&UPDI_USART_MODULE)) {
+      UPDI::LASTH = USART::read_status(&UPDI_USART_MODULE);
+      UPDI::LASTL = USART::read(&UPDI_USART_MODULE);
       j = 0;
     }
   } while (--j);
+  #ifdef UPDI_GANG_MODULES
+  gang_drain();
+  #endif
 }
 
 void UPDI::BREAK (bool longbreak, bool use_hv) {
+  UPDI::shadow_invalidate();
   uint16_t baud_reg = UPDI_USART_MODULE.BAUD;
   UPDI_USART_MODULE.BAUD = longbreak ? ~1 : (baud_reg << 2);
+  #ifdef UPDI_GANG_MODULES
+  /* the BREAK reaches every secondary and ends any merge mode,
+    a dropped secondary stays dropped until the next UPDI_CMD_ENTER */
+  UPDI::GANG_MERGE = UPDI::GANG_STRICT;
+  gang_baud(UPDI_USART_MODULE.BAUD);
+  while (!USART::is_tx_ready(&UPDI_USART_MODULE));
+  USART::write(&UPDI_USART_MODULE, 0x00);
+  for (uint8_t i = 0; i < GANG_COUNT; i++) USART::write(GANG[i].module, 0x00);
+  while (!USART::is_tx_complete(&UPDI_USART_MODULE));
+  for (uint8_t i = 0; i < GANG_COUNT; i++) while (!USART::is_tx_complete(GANG[i].module));
+  gang_baud(baud_reg);
+  #else
   UPDI::SEND(0x00);
+  #endif
   UPDI_USART_MODULE.BAUD = baud_reg;
 
   if (use_hv) {
@@ -108,36 +279,50 @@ void UPDI::BREAK (bool longbreak, bool use_hv) {
     TIMER::delay_us(5);               // UPDI:HI-Z HV:Hi-Z
     UPDI::SEND(0xFE);                 // UPDI:LOW  HV:Hi-Z
     UPDI::set_control(UPDI::HV_ENABLE);
+    #ifdef ENABLE_STATISTICS
+    PROF::stats.hv_entries++;
+    #endif
     TIMER::delay(4);                  // UPDI:Hi-Z HV:Hi-Z
   }
 
   loop_until_bit_is_set(UPDI_USART_PORT.IN, UPDI_TDAT_PIN);
-  UPDI::LASTH = UPDI_USART_MODULE.RXDATAH;
-  UPDI::LASTL = UPDI_USART_MODULE.RXDATAL;
+  UPDI::LASTH = USART::read_status(&UPDI_USART_MODULE);
+  UPDI::LASTL = USART::read(&UPDI_USART_MODULE);
   UPDI_USART_MODULE.STATUS =
   UPDI_USART_MODULE.RXDATAH = 0;
+  #ifdef UPDI_GANG_MODULES
+  gang_drain();
+  #endif
 }
 
 uint8_t UPDI::RECV (void) {
   /* receive symbol */
-  loop_until_bit_is_set(UPDI_USART_MODULE.STATUS, USART_RXCIF_bp);
-  UPDI::LASTH = UPDI_USART_MODULE.RXDATAH ^ 0x80;
+  while (!USART::is_rx_ready(&UPDI_USART_MODULE));
+  UPDI::LASTH = USART::read_status(&UPDI_USART_MODULE) ^ 0x80;
+  #ifdef ENABLE_STATISTICS
+  if (UPDI::LASTH & (USART_PERR_bm | USART_FERR_bm)) PROF::stats.parity++;
+  #endif
 
   #ifdef DEBUG_UPDI_LOOPBACK
 
-  UPDI::LASTL = UPDI_USART_MODULE.RXDATAL;
+  UPDI::LASTL = USART::read(&UPDI_USART_MODULE);
   DBG::write('<'); DBG::write_hex(UPDI::LASTL);
   return UPDI::LASTL;
 
+  #elif defined(UPDI_GANG_MODULES)
+
+  UPDI::LASTL = USART::read(&UPDI_USART_MODULE);
+  return UPDI::LASTL = gang_recv(UPDI::LASTL);
+
   #else
 
-  return UPDI::LASTL = UPDI_USART_MODULE.RXDATAL;
+  return UPDI::LASTL = USART::read(&UPDI_USART_MODULE);
 
   #endif
 }
 
 bool UPDI::SEND (const uint8_t data) {
-  loop_until_bit_is_set(UPDI_USART_MODULE.STATUS, USART_DREIF_bp);
+  while (!USART::is_tx_ready(&UPDI_USART_MODULE));
 
   #ifdef DEBUG_UPDI_LOOPBACK
   DBG::write('>');
@@ -145,9 +330,12 @@ bool UPDI::SEND (const uint8_t data) {
   #endif
 
   /* sending symbol */
-  UPDI_USART_MODULE.STATUS |= USART_TXCIF_bm;
-  UPDI_USART_MODULE.TXDATAL = data;
-  loop_until_bit_is_set(UPDI_USART_MODULE.STATUS, USART_TXCIF_bp);
+  USART::write(&UPDI_USART_MODULE, data);
+  #ifdef UPDI_GANG_MODULES
+  gang_write(data);
+  gang_wait_tx();
+  #endif
+  while (!USART::is_tx_complete(&UPDI_USART_MODULE));
 
   /* loopback symbol verify */
   bool _r = data == UPDI::RECV();
@@ -156,6 +344,8 @@ bool UPDI::SEND (const uint8_t data) {
 }
 
 size_t UPDI::send_bytes (const uint8_t *data, size_t len) {
+  #if defined(DEBUG_UPDI_LOOPBACK) || defined(UPDI_GANG_MODULES)
+
   uint8_t *p = (uint8_t*)(void*)data;
   size_t _count = 0;
   while (len--) {
@@ -163,14 +353,53 @@ size_t UPDI::send_bytes (const uint8_t *data, size_t len) {
     _count++;
   }
   return _count;
+
+  #else
+
+  /* Keep TXDATA full and verify the loopback from the RX FIFO behind it */
+  const uint8_t *p = data;        // next symbol to send
+  const uint8_t *q = data;        // next loopback to verify
+  const uint8_t *e = data + len;
+  bool _r = true;
+  while (q != e) {
+    if (p != e && (p - q) < 2
+      && USART::is_tx_ready(&UPDI_USART_MODULE)) {
+      USART::write(&UPDI_USART_MODULE, *p++);
+    }
+    if (USART::is_rx_ready(&UPDI_USART_MODULE)) {
+      if (*q++ != UPDI::RECV()) {
+        UPDI::LASTH |= 0x20;
+        _r = false;
+      }
+    }
+  }
+  return _r ? len : 0;
+
+  #endif
 }
 
-bool UPDI::send_repeat_header (uint8_t cmd, uint32_t addr, size_t len) {
+/* Set the target PTR unless it already points there */
+bool UPDI::st_ptr (uint32_t addr) {
   static uint8_t set_ptr[] = {
       UPDI::UPDI_SYNCH
     , UPDI::UPDI_ST | UPDI::UPDI_PTR_REG | UPDI::UPDI_DATA3
     , 0, 0, 0, 0  // qword address
   };
+  if (UPDI::PTR_SHADOW == addr) return true;
+  /* NVMCTRL v0 targets have a 16-bit UPDI pointer */
+  bool _a16 = UPDI::is_a16();
+  size_t _len = _a16 ? 4 : 5;
+  set_ptr[1] = UPDI::UPDI_ST | UPDI::UPDI_PTR_REG | (_a16 ? UPDI::UPDI_DATA2 : UPDI::UPDI_DATA3);
+  *((uint32_t*)&set_ptr[2]) = addr;
+  if (UPDI::send_bytes(set_ptr, _len) == _len && UPDI::UPDI_ACK == UPDI::RECV()) {
+    UPDI::PTR_SHADOW = addr;
+    return true;
+  }
+  UPDI::ptr_invalidate();
+  return false;
+}
+
+bool UPDI::send_repeat_header (uint8_t cmd, uint32_t addr, size_t len) {
   static uint8_t set_repeat[] = {
       UPDI::UPDI_SYNCH
     , UPDI::UPDI_REPEAT | UPDI::UPDI_DATA1
@@ -179,13 +408,16 @@ bool UPDI::send_repeat_header (uint8_t cmd, uint32_t addr, size_t len) {
     , UPDI::UPDI_PTR_INC  // +cmd
   };
   for (;;) {
-    *((uint32_t*)&set_ptr[2]) = addr;
     set_repeat[2] = len - 1;
     set_repeat[4] = UPDI::UPDI_PTR_INC | cmd;
-    if (UPDI::send_bytes(set_ptr, sizeof(set_ptr)-1) != sizeof(set_ptr)-1) break;
-    if (UPDI::UPDI_ACK != UPDI::RECV()) break;
-    return UPDI::send_bytes(set_repeat, sizeof(set_repeat)) == sizeof(set_repeat);
+    /* A contiguous access continues from the current PTR */
+    if (!UPDI::st_ptr(addr)) break;
+    if (UPDI::send_bytes(set_repeat, sizeof(set_repeat)) != sizeof(set_repeat)) break;
+    /* The caller receives every symbol or the transfer ends in a BREAK */
+    UPDI::PTR_SHADOW = addr + (len << (cmd & UPDI::UPDI_DATA2 ? 1 : 0));
+    return true;
   }
+  UPDI::ptr_invalidate();
   return false;
 }
 
@@ -195,9 +427,13 @@ bool UPDI::st8 (uint32_t addr, uint8_t data) {
     , UPDI::UPDI_STS | UPDI::UPDI_ADDR3 | UPDI::UPDI_DATA1
     , 0, 0, 0, 0  // qword address
   };
+  /* The lower 64KiB of data space is reached with a word address */
+  bool _a16 = (addr >> 16) == 0;
+  size_t _len = _a16 ? 4 : 5;
+  set_ptr[1] = UPDI::UPDI_STS | (_a16 ? UPDI::UPDI_ADDR2 : UPDI::UPDI_ADDR3) | UPDI::UPDI_DATA1;
   for (;;) {
     *((uint32_t*)&set_ptr[2]) = addr;
-    if (UPDI::send_bytes(set_ptr, sizeof(set_ptr)-1) != sizeof(set_ptr)-1) break;
+    if (UPDI::send_bytes(set_ptr, _len) != _len) break;
     if (UPDI::UPDI_ACK != UPDI::RECV()) break;
     if (!UPDI::SEND(data)) break;
     return UPDI::UPDI_ACK == UPDI::RECV();
@@ -206,15 +442,42 @@ bool UPDI::st8 (uint32_t addr, uint8_t data) {
 }
 
 size_t UPDI::sts8 (uint32_t addr, uint8_t *data, size_t len) {
-  size_t cnt = 0;
-  if (UPDI::send_repeat_header((UPDI::UPDI_ST | UPDI::UPDI_DATA1), addr, len)) {
-    while (cnt < len) {
-      if (!UPDI::SEND(*data++)) break;
-      if (UPDI::UPDI_ACK != RECV()) break;
-      cnt++;
-    }
-  }
-  return cnt;
+  return UPDI::sts_burst(addr, data, len) ? len : 0;
+}
+
+/* Burst store with RSD : errors are checked once by STATUSB PESIG */
+bool UPDI::sts_burst (uint32_t addr, const uint8_t *data, size_t len, bool is_word) {
+  static uint8_t set_repeat_rsd[] = {
+      UPDI::UPDI_SYNCH
+    , UPDI::UPDI_STCS    | UPDI::UPDI_CS_CTRLA
+    , UPDI::UPDI_SET_RSD | UPDI::UPDI_SET_GTVAL_2
+    , UPDI::UPDI_SYNCH
+    , UPDI::UPDI_REPEAT  | UPDI::UPDI_DATA1
+    , 0                 // $05:repeat count
+    , UPDI::UPDI_SYNCH
+    , UPDI::UPDI_ST | UPDI::UPDI_PTR_INC  // $07:+data size
+  };
+  if (is_word) len >>= 1;
+  if (len == 0 || len > 256) return false;
+
+  /* setting register pointer unless it already points there */
+  if (!UPDI::st_ptr(addr)) return false;
+
+  /* enable RSD mode */
+  set_repeat_rsd[5] = (uint8_t)len - 1;
+  set_repeat_rsd[7] = UPDI::UPDI_ST | UPDI::UPDI_PTR_INC | (is_word ? UPDI::UPDI_DATA2 : UPDI::UPDI_DATA1);
+  UPDI::ptr_invalidate();
+  if (UPDI::send_bytes(set_repeat_rsd, sizeof(set_repeat_rsd)) != sizeof(set_repeat_rsd)) return false;
+
+  /* no ACK is returned for each store */
+  if (is_word) len <<= 1;
+  bool _r = UPDI::send_bytes(data, len) == len;
+
+  /* disable RSD mode and check the error signature */
+  if (!UPDI::set_cs_ctra(UPDI::UPDI_SET_GTVAL_2)) return false;
+  _r = _r && (UPDI::ldcs(UPDI::UPDI_CS_STATUSB) & UPDI::UPDI_ERR_PESIG_bm) == 0;
+  if (_r) UPDI::PTR_SHADOW = addr + len;
+  return _r;
 }
 
 uint8_t UPDI::ld8 (uint32_t addr) {
@@ -223,6 +486,8 @@ uint8_t UPDI::ld8 (uint32_t addr) {
     , UPDI::UPDI_LDS | UPDI::UPDI_ADDR3 | UPDI::UPDI_DATA1
     , 0, 0, 0, 0  // qword address
   };
+  /* The lower 64KiB of data space is reached with a word address */
+  if ((addr >> 16) == 0) return UPDI::ld8_a16(addr);
   for (;;) {
     *((uint32_t*)&set_ptr[2]) = addr;
     if (UPDI::send_bytes(set_ptr, sizeof(set_ptr)-1) == sizeof(set_ptr)-1) {
@@ -233,6 +498,30 @@ uint8_t UPDI::ld8 (uint32_t addr) {
   }
 }
 
+uint8_t UPDI::ldcs (const uint8_t code) {
+  static uint8_t set_ptr[] = { UPDI::UPDI_SYNCH, 0 };
+  set_ptr[1] = UPDI::UPDI_LDCS | code;
+  if (UPDI::send_bytes(set_ptr, sizeof(set_ptr)) != sizeof(set_ptr)) return 0;
+  return UPDI::RECV();
+}
+
+/* Short LDS for the lower 64KiB : NVMCTRL and IO registers */
+uint8_t UPDI::ld8_a16 (uint16_t addr) {
+  static uint8_t set_ptr[] = {
+      UPDI::UPDI_SYNCH
+    , UPDI::UPDI_LDS | UPDI::UPDI_ADDR2 | UPDI::UPDI_DATA1
+    , 0, 0        // word address
+  };
+  for (;;) {
+    *((uint16_t*)&set_ptr[2]) = addr;
+    if (UPDI::send_bytes(set_ptr, sizeof(set_ptr)) == sizeof(set_ptr)) {
+      return RECV();
+    }
+    /* fallback */
+    UPDI::BREAK();
+  }
+}
+
 bool UPDI::is_cs_stat (const uint8_t code, const uint8_t check) {
   static uint8_t set_ptr[] = { UPDI::UPDI_SYNCH, 0 };
   for (;;) {
@@ -255,59 +544,71 @@ bool UPDI::set_cs_stat (const uint8_t code, const uint8_t data) {
 /* inline bool reset (bool logic);  // UPDI_CS_ASI_RESET_REQ, UPDI_RSTREQ */
 
 bool UPDI::loop_until_sys_stat_is_clear (uint8_t bitmap, uint16_t limit) {
+  bool _r = false;
   #ifdef ENABLE_DEBUG_UPDI_SENDER
   uint16_t _back = _send_ptr;
   #endif
+  UPDI::gang_merge(UPDI::GANG_OR);
   do {
-    if (!is_sys_stat(bitmap)) return true;
+    if (!is_sys_stat(bitmap)) { _r = true; break; }
     #ifdef ENABLE_DEBUG_UPDI_SENDER
     _send_ptr = _back;
     #endif
     TIMER::delay_us(50);
   } while (--limit);
-  return false;
+  UPDI::gang_merge(UPDI::GANG_STRICT);
+  return _r;
 }
 
 bool UPDI::loop_until_sys_stat_is_set (uint8_t bitmap, uint16_t limit) {
+  bool _r = false;
   #ifdef ENABLE_DEBUG_UPDI_SENDER
   uint16_t _back = _send_ptr;
   #endif
+  UPDI::gang_merge(UPDI::GANG_AND);
   do {
-    if (is_sys_stat(bitmap)) return true;
+    if (is_sys_stat(bitmap)) { _r = true; break; }
     #ifdef ENABLE_DEBUG_UPDI_SENDER
     _send_ptr = _back;
     #endif
     TIMER::delay_us(50);
   } while (--limit);
-  return false;
+  UPDI::gang_merge(UPDI::GANG_STRICT);
+  return _r;
 }
 
 bool UPDI::loop_until_key_stat_is_clear (uint8_t bitmap, uint16_t limit) {
+  bool _r = false;
   #ifdef ENABLE_DEBUG_UPDI_SENDER
   uint16_t _back = _send_ptr;
   #endif
+  UPDI::gang_merge(UPDI::GANG_OR);
   do {
-    if (!is_key_stat(bitmap)) return true;
+    if (!is_key_stat(bitmap)) { _r = true; break; }
     #ifdef ENABLE_DEBUG_UPDI_SENDER
     _send_ptr = _back;
     #endif
     TIMER::delay_us(50);
   } while (--limit);
-  return false;
+  UPDI::gang_merge(UPDI::GANG_STRICT);
+  return _r;
 }
 
 bool UPDI::loop_until_key_stat_is_set (uint8_t bitmap, uint16_t limit) {
+  bool _r = false;
   #ifdef ENABLE_DEBUG_UPDI_SENDER
   uint16_t _back = _send_ptr;
   #endif
+  UPDI::gang_merge(UPDI::GANG_AND);
   do {
-    if (is_key_stat(bitmap)) return true;
+    if (is_key_stat(bitmap)) { _r = true; break; }
     #ifdef ENABLE_DEBUG_UPDI_SENDER
     _send_ptr = _back;
     #endif
     TIMER::delay_us(50);
   } while (--limit);
-  return false;
+  UPDI::gang_merge(UPDI::GANG_STRICT);
+  return _r;
 }
 
 bool UPDI::read_parameter (void) {
@@ -331,7 +632,8 @@ bool UPDI::read_parameter (void) {
       signature[0] = 0x1E;
       signature[1] = updi_sib[0] == ' ' ? updi_sib[4] : updi_sib[0];
       signature[2] = updi_sib[10];
-      UPDI::NVMPROGVER = updi_sib[10];
+      /* A version without a built in driver is left unprogrammable */
+      UPDI::NVMPROGVER = NVM::is_built(updi_sib[10]) ? updi_sib[10] : 0;
       UPDI::set_control(UPDI::UPDI_ACTIVE);
       #ifdef DEBUG_USE_USART
       DBG::print("[SIB]"); DBG::write(&updi_sib[0], 32, false);
@@ -458,13 +760,17 @@ bool UPDI::enter_updi (void) {
   ABORT::stop_timer();
   UPDI::tdir_pull();
   UPDI::NVMPROGVER = 0;
+  #ifdef ENABLE_WARM_ENTRY
+  UPDI::NVMPROG_HELD = false;
+  #endif
   UPDI::clear_control(UPDI::UPDI_ACTIVE | /* UPDI::UPDI_LOWBAUD | */ UPDI::ENABLE_NVMPG);
   SYS::pgen_enable();
   // SYS::trst_disable();
   for (uint8_t i = 0; i < 3; i++) {
     if (setjmp(ABORT::CONTEXT) == 0) {
       ABORT::start_timer(ABORT::CONTEXT, 100);
-      // UPDI::fallback_speed(UPDI_USART_BAUDRATE >> i);
+      /* the previous session may have left a high speed */
+      UPDI::fallback_speed(UPDI_USART_BAUDRATE);
       SYS::trst_enable();
       TIMER::delay_us(250);
       SYS::trst_disable();
@@ -482,16 +788,52 @@ bool UPDI::enter_updi (void) {
       DBG::print("(U_TO)", false);
       #endif
     }
-    // UPDI::set_control(UPDI::UPDI_LOWBAUD);
   }
   return result;
 }
 
+#ifdef ENABLE_WARM_ENTRY
+/* The last session left NVMPROG enabled : only the SIB is read again */
+/* The SIB read also refuses a target swapped since then */
+/* Nothing is probed unless this programmer left the target in NVMPROG */
+bool UPDI::resume_updi (void) {
+  volatile bool result = false;
+  if (!UPDI::NVMPROG_HELD) return false;
+  ABORT::stop_timer();
+  UPDI::tdir_pull();
+  UPDI::NVMPROGVER = 0;
+  UPDI::clear_control(UPDI::UPDI_ACTIVE | UPDI::ENABLE_NVMPG);
+  SYS::pgen_enable();
+  if (setjmp(ABORT::CONTEXT) == 0) {
+    /* no answer in time : UPDI is disabled, so the cold entry follows */
+    ABORT::start_timer(ABORT::CONTEXT, 20);
+    UPDI::fallback_speed(UPDI_USART_BAUDRATE);
+    UPDI::BREAK();
+    if (UPDI::is_sys_stat(UPDI::UPDI_SYS_NVMPROG)
+      && UPDI::read_parameter() && UPDI::NVMPROGVER) {
+      UPDI::set_control(UPDI::ENABLE_NVMPG);
+      #ifdef DEBUG_USE_USART
+      DBG::print("[WARM]", false);
+      #endif
+      result = true;
+    }
+    ABORT::stop_timer();
+  }
+  else {
+    ABORT::stop_timer();
+  }
+  return result;
+}
+#endif
+
 bool UPDI::leave_updi (void) {
   for (;;) {
     if (!(UPDI::reset(true) && UPDI::reset(false))) break;
 
     /* leave updi */
+    #ifdef ENABLE_WARM_ENTRY
+    UPDI::NVMPROG_HELD = false;
+    #endif
     if (!UPDI::set_cs_stat(UPDI::UPDI_CS_CTRLB, UPDI::UPDI_SET_UPDIDIS)) break;
     #ifdef DEBUG_USE_USART
     DBG::print("[U_OF]"); // UPDI disabled
@@ -561,16 +903,55 @@ bool UPDI::write_userrow(uint32_t start_addr, size_t byte_count) {
 /* UPDI action */
 bool UPDI::runtime (uint8_t updi_cmd) {
   volatile bool _result = false;
+  #ifdef ENABLE_PROFILE
+  uint32_t _prof = PROF::start();
+  #endif
   ABORT::stop_timer();
   UPDI::clear_control(UPDI::UPDI_FALT | UPDI::UPDI_TIMEOUT);
+  NVM::nvm_wait_cancel();
+  #ifdef UPDI_HIGH_BAUDRATE
+  /* The request header is overwritten by the answer : kept for a retry */
+  uint8_t _request[10];
+  memcpy(_request, JTAG2::packet.body, sizeof(_request));
+  #endif
+  #ifdef ENABLE_READ_AHEAD
+  /* Anything but a flash read may change what the target returns */
+  if (updi_cmd != UPDI::UPDI_CMD_READ_MEMORY
+    && updi_cmd != UPDI::UPDI_CMD_READ_AHEAD) NVM::read_ahead_clear();
+  #endif
   if (setjmp(ABORT::CONTEXT) == 0) {
     ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
     switch (updi_cmd) {
       case UPDI::UPDI_CMD_ENTER : {
+        #ifdef UPDI_GANG_MODULES
+        /* A new connection starts with every target in the gang */
+        UPDI::gang_restore();
+        #endif
+        #ifdef ENABLE_WARM_ENTRY
+        if (UPDI::resume_updi()) {
+          ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+          _result = true;
+          UPDI::speed_up();
+        }
+        else
+        #endif
         if (UPDI::enter_updi()) {
           ABORT::start_timer(ABORT::CONTEXT, UPDI_ABORT_MS);
+          #ifdef ENABLE_PROFILE
+          uint32_t _key = PROF::start();
+          #endif
           _result = UPDI::enter_nvmprog();
+          #ifdef ENABLE_PROFILE
+          PROF::stop(PROF::PROF_KEY_ENTRY, _key);
+          #endif
+          if (_result) UPDI::speed_up();
         }
+        #ifdef ENABLE_WARM_ENTRY
+        UPDI::NVMPROG_HELD = _result;
+        #endif
+        #ifdef ENABLE_STATISTICS
+        if (_result) PROF::stats.sessions++;
+        #endif
         break;
       }
       case UPDI::UPDI_CMD_LEAVE : {
@@ -583,6 +964,11 @@ bool UPDI::runtime (uint8_t updi_cmd) {
       case UPDI::UPDI_CMD_READ_MEMORY : {
         _result = NVM::read_memory(); break;
       }
+      #ifdef ENABLE_READ_AHEAD
+      case UPDI::UPDI_CMD_READ_AHEAD : {
+        _result = NVM::read_ahead(); break;
+      }
+      #endif
       case UPDI::UPDI_CMD_WRITE_MEMORY : {
         if (UPDI::NVMPROGVER == 0) break;
         #ifdef DEBUG_USE_USART
@@ -596,6 +982,9 @@ bool UPDI::runtime (uint8_t updi_cmd) {
           #ifdef DEBUG_USE_USART
           DBG::print("(RTY)");
           #endif
+          #ifdef ENABLE_STATISTICS
+          PROF::stats.retries++;
+          #endif
           _result = NVM::write_memory();
         }
         #endif 
@@ -629,9 +1018,45 @@ bool UPDI::runtime (uint8_t updi_cmd) {
     DBG::print("(U_TO)"); // UPDI TIMEOUT
     #endif
     UPDI::BREAK();
+    /* A burst cut short leaves RSD on : no later store would be acknowledged */
+    UPDI::set_cs_ctra(UPDI::UPDI_SET_GTVAL_2);
     UPDI::set_control(UPDI::UPDI_TIMEOUT);
+    #ifdef ENABLE_STATISTICS
+    PROF::stats.timeouts++;
+    PROF::stats.breaks++;
+    #endif
+    #ifdef ENABLE_READ_AHEAD
+    NVM::read_ahead_clear();
+    #endif
   }
   if (!_result) UPDI::set_control(UPDI::UPDI_FALT);
+  #ifdef ENABLE_STATISTICS
+  if (!_result) PROF::stats.faults++;
+  #endif
+  #ifdef UPDI_HIGH_BAUDRATE
+  /* Parity or ACK errors at high speed : stay at the base rate from now on */
+  /* and run the command once more there. The next session of this target */
+  /* starts its probe one step lower. A streamed answer has already begun, */
+  /* so that read is left to the host to repeat. */
+  if (UPDI::is_control(UPDI::UPDI_FALT | UPDI::UPDI_TIMEOUT)
+    && UPDI::BAUDRATE > UPDI_USART_BAUDRATE) {
+    UPDI::SPEED_BAUDRATE = UPDI::BAUDRATE >> 1;
+    UPDI::fallback_speed(UPDI_USART_BAUDRATE);
+    UPDI::set_control(UPDI::UPDI_LOWBAUD);
+    UPDI::BREAK();
+    UPDI::set_cs_ctra(UPDI::UPDI_SET_GTVAL_2);
+    #ifdef ENABLE_STATISTICS
+    PROF::stats.breaks++;
+    #endif
+    if (!(updi_cmd == UPDI::UPDI_CMD_READ_MEMORY && JTAG2::is_control(JTAG2::ANS_POSTED))) {
+      #ifdef ENABLE_STATISTICS
+      PROF::stats.retries++;
+      #endif
+      memcpy(JTAG2::packet.body, _request, sizeof(_request));
+      _result = UPDI::runtime(updi_cmd);
+    }
+  }
+  #endif
   #ifdef DEBUG_USE_USART
   if (!_result) {
     DBG::write('#');
@@ -643,6 +1068,9 @@ bool UPDI::runtime (uint8_t updi_cmd) {
     DBG::print("(U_OK)", false);
   }
   #endif
+  #ifdef ENABLE_PROFILE
+  PROF::stop(PROF::PROF_UPDI_CMD + updi_cmd, _prof);
+  #endif
   return _result;
 }
 
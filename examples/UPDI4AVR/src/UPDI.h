@@ -21,6 +21,12 @@ namespace UPDI {
   extern volatile uint8_t LASTH;
   extern uint8_t CONTROL;
   extern uint8_t NVMPROGVER;
+  extern uint32_t BAUDRATE;
+  extern uint32_t PTR_SHADOW;
+  extern int16_t NVMCMD_SHADOW;
+  #ifdef ENABLE_WARM_ENTRY
+  extern bool NVMPROG_HELD;
+  #endif
 
   /* UPDI::CONTROL flags */
   enum updi_control_e {
@@ -40,6 +46,7 @@ namespace UPDI {
     , UPDI_CMD_WRITE_MEMORY
     , UPDI_CMD_TARGET_RESET
     , UPDI_CMD_ERASE
+    , UPDI_CMD_READ_AHEAD
   };
   enum updi_operate_e {
     /* UPDI command */
@@ -139,6 +146,7 @@ namespace UPDI {
 
   void setup (void);
   void fallback_speed (uint32_t baudrate);
+  bool speed_up (void);
 
   inline uint8_t is_control (uint8_t value) {
     return UPDI::CONTROL & value;
@@ -152,18 +160,66 @@ namespace UPDI {
 
   void drain (void);
 
+  /* true : The target UPDI has a 16-bit address space (by SIB) */
+  inline bool is_a16 (void) {
+    return UPDI::NVMPROGVER == '0';
+  }
+
+  /* Gang programming : how the answers of the secondary targets are used */
+  enum gang_merge_e {
+      GANG_STRICT   // must equal the primary, a differing target is dropped
+    , GANG_OR       // OR of all targets : waiting for a bit to clear
+    , GANG_AND      // AND of all targets : waiting for a bit to set
+  };
+  #ifdef UPDI_GANG_MODULES
+  /* A secondary target : one entry of UPDI_GANG_MODULES */
+  struct gang_module_t {
+    volatile USART_t *module;
+    volatile uint8_t *tdat_ctrl;    // PINnCTRL of the TXD pin
+    volatile uint8_t *route;        // PORTMUX.USARTROUTEA or USARTROUTEB
+    uint8_t route_gc;               // PORTMUX_USARTn_xxx_gc
+  };
+  extern uint8_t GANG_ACTIVE;
+  extern uint8_t GANG_MERGE;
+  void gang_restore (void);
+  inline void gang_merge (uint8_t mode) {
+    UPDI::GANG_MERGE = mode;
+  }
+  /* true : secondary targets are still written in lock-step */
+  inline bool is_gang (void) {
+    return UPDI::GANG_ACTIVE != 0;
+  }
+  #else
+  inline void gang_merge (uint8_t mode) { (void)mode; }
+  inline bool is_gang (void) { return false; }
+  #endif
+
+  /* The target PTR is unknown after a BREAK, reset or failed transfer */
+  inline void ptr_invalidate (void) {
+    UPDI::PTR_SHADOW = ~0;
+  }
+  /* Every shadowed target register is unknown after a BREAK or reset */
+  inline void shadow_invalidate (void) {
+    UPDI::ptr_invalidate();
+    UPDI::NVMCMD_SHADOW = -1;
+  }
+
   void BREAK (bool longbreak = false, bool use_hv = false);
   bool SEND (const uint8_t data);
   uint8_t RECV (void);
 
   size_t send_bytes (const uint8_t *data, size_t len);
+  bool st_ptr (uint32_t addr);
   bool send_repeat_header (uint8_t cmd, uint32_t addr, size_t len);
 
   bool st8 (uint32_t addr, uint8_t data);
   size_t sts8 (uint32_t addr, uint8_t *data, size_t len);
+  bool sts_burst (uint32_t addr, const uint8_t *data, size_t len, bool is_word = false);
 
   uint8_t ld8 (uint32_t addr);
+  uint8_t ld8_a16 (uint16_t addr);
 
+  uint8_t ldcs (const uint8_t code);
   bool is_cs_stat (const uint8_t code, const uint8_t check);
   inline bool is_sys_stat (const uint8_t check) {
     return is_cs_stat(UPDI_CS_ASI_SYS_STATUS, check);
@@ -176,6 +232,7 @@ namespace UPDI {
   }
   bool set_cs_stat (const uint8_t code, const uint8_t data);
   inline bool reset (bool logic) {
+    UPDI::shadow_invalidate();
     return set_cs_stat(UPDI_CS_ASI_RESET_REQ, (logic ? UPDI_RSTREQ : 0));
   }
   inline bool set_cs_ctra (const uint8_t data) {
@@ -190,6 +247,7 @@ namespace UPDI {
   bool chip_erase (void);
   bool enter_nvmprog (void);
   bool enter_updi (void);
+  bool resume_updi (void);
   bool leave_updi (void);
   bool write_userrow(uint32_t start_addr, size_t byte_count);
 
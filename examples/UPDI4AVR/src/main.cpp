@@ -11,9 +11,12 @@
 #include "../configuration.h"
 #include "JTAG2.h"
 #include "UPDI.h"
+#include "NVM.h"
 #include "sys.h"
 #include "timer.h"
 #include "abort.h"
+#include "prof.h"
+#include "store.h"
 #include "dbg.h"
 
 // Prototypes
@@ -40,9 +43,19 @@ namespace {
     DBG::print_dec(F_CPU);
     #endif
 
+    #ifdef ENABLE_PROFILE
+    PROF::clear();
+    #endif
+    #ifdef ENABLE_STATISTICS
+    PROF::stats_clear();
+    #endif
+
     ABORT::setup();
     UPDI::setup();
     JTAG2::setup();
+    #ifdef ENABLE_IMAGE_STORE
+    STORE::setup();
+    #endif
     ABORT::stop_timer();
 
     SYS::trst_enable();
@@ -63,7 +76,14 @@ namespace {
       sig_interrupt = 2;
 
       /* run JTAG2 command */
+      #ifdef ENABLE_PROFILE
+      uint8_t _slot = PROF::cmnd_slot(JTAG2::packet.body[0]);
+      uint32_t _prof = PROF::start();
+      #endif
       if (!process_command()) sig_interrupt = 0;
+      #ifdef ENABLE_PROFILE
+      PROF::stop(_slot, _prof);
+      #endif
     }
 
     /* RTS/DTR signal abort */
@@ -83,6 +103,12 @@ namespace {
         DBG::print("!MAKE");
         #endif
 
+        #ifdef ENABLE_IMAGE_STORE
+        /* Standalone programming : the stored image goes first */
+        /* A host opening the port never triggers it, only the strap does */
+        if (STORE::STATE == STORE::STORE_ARMED && STORE::is_standalone()) STORE::replay();
+        #endif
+
         UPDI::runtime(UPDI::UPDI_CMD_ENTER);
       }
 
@@ -160,8 +186,29 @@ namespace {
     DBG::print_dec(JTAG2::packet.number);
     #endif
     uint8_t message_id = JTAG2::packet.body[0];
+    #if defined(ENABLE_PACKED_WRITE) || defined(ENABLE_PROFILE)
+    size_t body_size = JTAG2::packet.size;
+    #endif
     JTAG2::packet.size_word[0] = 1;
     JTAG2::packet.body[0] = JTAG2::RSP_OK;
+    #ifdef ENABLE_POSTED_WRITE
+    /* A posted write has failed : the next write is refused in its place */
+    /* [RSP_ILLEGAL_MCU_STATE, JTAG2::CONTROL, UPDI::CONTROL, failed address] */
+    /* Reads and other requests run as usual, so the host can still verify */
+    if (JTAG2::is_control(JTAG2::POSTED_FALT)
+      && message_id == JTAG2::CMND_WRITE_MEMORY) {
+      JTAG2::clear_control(JTAG2::POSTED_FALT);
+      #ifdef DEBUG_USE_USART
+      DBG::print(">!POST=", false);
+      DBG::print_hex(JTAG2::posted_addr);
+      #endif
+      JTAG2::set_response(JTAG2::RSP_ILLEGAL_MCU_STATE);
+      *((uint32_t*)&JTAG2::packet.body[3]) = JTAG2::posted_addr;
+      JTAG2::packet.size = 7;
+      JTAG2::answer_transfer();
+      return JTAG2::answer_after_change();
+    }
+    #endif
     switch (message_id) {
       case JTAG2::CMND_SIGN_OFF : {
         ABORT::stop_timer();
@@ -194,6 +241,10 @@ namespace {
         #ifdef DEBUG_USE_USART
         DBG::print(">GET_P", false);
         #endif
+        #ifdef ENABLE_PROFILE
+        /* PARAM_PROFILE without a slot number : slot 0, not a stale byte */
+        if (body_size < 3) JTAG2::packet.body[2] = 0;
+        #endif
         JTAG2::get_parameter(); break;
       }
       case JTAG2::CMND_SET_DEVICE_DESCRIPTOR : {
@@ -217,7 +268,27 @@ namespace {
         if (!UPDI::runtime(UPDI::UPDI_CMD_READ_MEMORY)) {
           JTAG2::set_response(JTAG2::RSP_ILLEGAL_MCU_STATE);
         }
-        break;
+        #ifdef ENABLE_STATISTICS
+        if (JTAG2::packet.body[0] == JTAG2::RSP_MEMORY) {
+          PROF::stats.bytes_read += JTAG2::packet.size_word[0] - 1;
+        }
+        #endif
+        #ifdef ENABLE_STREAM_READ
+        /* Already streamed : a failure after the header still ends the frame */
+        if (JTAG2::is_control(JTAG2::ANS_POSTED)) {
+          JTAG2::clear_control(JTAG2::ANS_POSTED);
+          JTAG2::stream_abort();
+        }
+        else
+        #endif
+        JTAG2::answer_transfer();
+        #ifdef ENABLE_READ_AHEAD
+        /* The host is busy with the answer : load the next block meanwhile */
+        if (JTAG2::packet.body[0] == JTAG2::RSP_MEMORY) {
+          UPDI::runtime(UPDI::UPDI_CMD_READ_AHEAD);
+        }
+        #endif
+        return JTAG2::answer_after_change();
       }
       case JTAG2::CMND_WRITE_MEMORY : {
         #ifdef DEBUG_USE_USART
@@ -225,13 +296,45 @@ namespace {
         #endif
         /* Received packet error retransmission exception */
         if (before_seqnum == JTAG2::packet.number) break;
+        #ifdef ENABLE_PACKED_WRITE
+        if (JTAG2::packet.body[1] == JTAG2::MTYPE_PACKED && !JTAG2::unpack(body_size)) {
+          JTAG2::set_response(JTAG2::RSP_ILLEGAL_VALUE);
+          break;
+        }
+        #endif
+        #ifdef ENABLE_IMAGE_STORE
+        /* the answer overwrites body[1..2] : keep the request type and size */
+        uint8_t _mem_type = JTAG2::packet.body[1];
+        size_t _byte_count = *((uint32_t*)&JTAG2::packet.body[2]);
+        #endif
+        #ifdef ENABLE_POSTED_WRITE
+        uint32_t _start_addr = *((uint32_t*)&JTAG2::packet.body[6]);
+        #endif
         if (UPDI::runtime(UPDI::UPDI_CMD_WRITE_MEMORY)) {
           /* Keep the sequence number if completed successfully */
           before_seqnum = JTAG2::packet.number;
+          #ifdef ENABLE_IMAGE_STORE
+          /* only a page the target accepted is kept */
+          STORE::record(_mem_type, _byte_count);
+          #endif
+          #ifdef ENABLE_STATISTICS
+          PROF::stats.pages++;
+          #endif
         }
         else {
           JTAG2::set_response(JTAG2::RSP_ILLEGAL_MCU_STATE);
         }
+        #ifdef ENABLE_POSTED_WRITE
+        /* Already answered : the result is reported on the next request */
+        if (JTAG2::is_control(JTAG2::ANS_POSTED)) {
+          JTAG2::clear_control(JTAG2::ANS_POSTED);
+          if (JTAG2::packet.body[0] != JTAG2::RSP_OK) {
+            JTAG2::posted_addr = _start_addr;
+            JTAG2::set_control(JTAG2::POSTED_FALT);
+          }
+          return JTAG2::answer_after_change();
+        }
+        #endif
         break;
       }
       case JTAG2::CMND_XMEGA_ERASE : {
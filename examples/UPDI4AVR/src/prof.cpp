@@ -0,0 +1,45 @@
+/**
+ * @file prof.cpp
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_PROFILE timing records and ENABLE_STATISTICS counters
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include "prof.h"
+
+#ifdef ENABLE_PROFILE
+
+namespace PROF {
+  prof_record_t records[PROF_SLOTS];
+}
+
+void PROF::clear (void) {
+  for (uint8_t i = 0; i < PROF_SLOTS; i++) {
+    PROF::records[i].min = ~0;
+    PROF::records[i].max = 0;
+    PROF::records[i].total = 0;
+    PROF::records[i].count = 0;
+  }
+}
+
+void PROF::stop (uint8_t slot, uint32_t start_us) {
+  uint32_t _span = TIMER::micros32() - start_us;
+  prof_record_t &_r = PROF::records[slot];
+  if (_span < _r.min) _r.min = _span;
+  if (_span > _r.max) _r.max = _span;
+  _r.total += _span;
+  _r.count++;
+}
+
+#endif  /* ENABLE_PROFILE */
+
+#ifdef ENABLE_STATISTICS
+namespace PROF {
+  stat_counter_t stats;
+}
+#endif  /* ENABLE_STATISTICS */
+
+// end of code
@@ -0,0 +1,80 @@
+/**
+ * @file prof.h
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_PROFILE timing records and ENABLE_STATISTICS counters
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <string.h>
+#include "../configuration.h"
+#include "timer.h"
+
+#ifdef ENABLE_PROFILE
+namespace PROF {
+  /* Measurement slots */
+  enum prof_slot_e {
+      PROF_RECEIVE    = 0x00  // JTAG2 frame receive and CRC
+    , PROF_ANSWER     = 0x01  // JTAG2 answer transmit
+    , PROF_KEY_ENTRY  = 0x02  // UPDI NVMPROG key entry
+    , PROF_NVM_WAIT   = 0x03  // NVMCTRL busy wait
+    , PROF_PAGE_STORE = 0x04  // UPDI page buffer store
+    , PROF_UPDI_CMD   = 0x05  // +UPDI::updi_command_e ($01-$08)
+    , PROF_JTAG_CMND  = 0x10  // +JTAG2::jtag_cmnd_e ($00-$15)
+    , PROF_JTAG_OTHER = 0x26  // other JTAG2 commands
+    , PROF_SLOTS
+  };
+
+  /* Microsecond figures : a single period over 71 minutes wraps around */
+  struct prof_record_t {
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint16_t count;
+  };
+
+  extern prof_record_t records[PROF_SLOTS];
+
+  void clear (void);
+  void stop (uint8_t slot, uint32_t start_us);
+  inline uint32_t start (void) {
+    return TIMER::micros32();
+  }
+  inline uint8_t cmnd_slot (uint8_t message_id) {
+    return message_id < (PROF_JTAG_OTHER - PROF_JTAG_CMND)
+      ? PROF_JTAG_CMND + message_id
+      : PROF_JTAG_OTHER;
+  }
+}
+#endif  /* ENABLE_PROFILE */
+
+#ifdef ENABLE_STATISTICS
+namespace PROF {
+  /* Session counters : the layout is the PARAM_STATS answer */
+  struct stat_counter_t {
+    uint32_t sessions;      // UPDI_CMD_ENTER completed
+    uint32_t pages;         // CMND_WRITE_MEMORY completed
+    uint32_t blank_skip;    // blank flash pages skipped after chip erase
+    uint32_t same_skip;     // unchanged flash pages skipped
+    uint32_t bytes_read;    // CMND_READ_MEMORY answered bytes
+    uint32_t nvm_wait_us;   // NVMCTRL busy wait total
+    uint32_t parity;        // UPDI symbols with parity or frame error
+    uint32_t retries;       // second attempts : WRITE_RETRY or at the base UPDI rate
+    uint32_t timeouts;      // UPDI_TIMEOUT
+    uint32_t faults;        // UPDI_FALT
+    uint32_t breaks;        // BREAK recoveries after a failed command
+    uint32_t hv_entries;    // high voltage UPDI enables
+  };
+
+  extern stat_counter_t stats;
+
+  inline void stats_clear (void) {
+    memset(&stats, 0, sizeof(stats));
+  }
+}
+#endif  /* ENABLE_STATISTICS */
+
+// end of code
@@ -0,0 +1,196 @@
+/**
+ * @file store.cpp
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_IMAGE_STORE : a recorded session kept in the programmer flash
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <avr/pgmspace.h>
+#include "store.h"
+#include "JTAG2.h"
+#include "UPDI.h"
+#include "NVM.h"
+#include "dbg.h"
+
+#ifdef ENABLE_IMAGE_STORE
+
+namespace STORE {
+  constexpr uint16_t MAGIC = 0x3455;          // "U4"
+  constexpr uint16_t HOST_PAGESIZE = 512;     // AVR Dx flash page
+  constexpr uint32_t RECORD_BASE = IMAGE_STORE_ADDR + HOST_PAGESIZE;
+  constexpr uint32_t STORE_END = IMAGE_STORE_ADDR + IMAGE_STORE_SIZE;
+
+  uint8_t STATE;
+  uint32_t tail;            // next free byte of the store area
+  store_header_t header;
+
+  /* Self programming of the host flash : NVMCTRL v2 */
+  #ifdef UPDI4AVR_HOST
+  /* A host side build writes the simulated flash instead */
+  void spm_word (uint32_t addr, uint16_t data);
+  #else
+  void spm_word (uint32_t addr, uint16_t data) {
+    RAMPZ = addr >> 16;
+    __asm__ __volatile__(
+        "movw r0, %A1" "\n\t"
+        "spm"          "\n\t"
+        "clr r1"
+      :
+      : "z" ((uint16_t)addr), "r" (data)
+      : "r0"
+    );
+    RAMPZ = 0;
+    while (NVMCTRL.STATUS & NVMCTRL_FBUSY_bm);
+  }
+  #endif
+
+  void nvm_command (uint8_t nvmcmd) {
+    while (NVMCTRL.STATUS & NVMCTRL_FBUSY_bm);
+    _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_NONE_gc);
+    if (nvmcmd != NVMCTRL_CMD_NONE_gc) _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, nvmcmd);
+  }
+
+  void erase_page (uint32_t addr) {
+    nvm_command(NVMCTRL_CMD_FLPER_gc);
+    spm_word(addr, 0xFFFF);
+    nvm_command(NVMCTRL_CMD_NONE_gc);
+  }
+
+  /* Append to an erased store : a new host page is erased on entry */
+  void write_words (uint32_t addr, const uint8_t *data, size_t len) {
+    while (len) {
+      if ((addr & (HOST_PAGESIZE - 1)) == 0) erase_page(addr);
+      nvm_command(NVMCTRL_CMD_FLWR_gc);
+      do {
+        spm_word(addr, *((uint16_t*)data));
+        addr += 2;
+        data += 2;
+        len -= 2;
+      } while (len && (addr & (HOST_PAGESIZE - 1)));
+      nvm_command(NVMCTRL_CMD_NONE_gc);
+    }
+  }
+
+  void read_header (void) {
+    uint8_t *p = (uint8_t*)&header;
+    for (uint8_t i = 0; i < sizeof(header); i++) {
+      *p++ = pgm_read_byte_far(IMAGE_STORE_ADDR + i);
+    }
+  }
+}
+
+/* The armed state survives power off for standalone use */
+void STORE::setup (void) {
+  PIN_CTRL(IMAGE_STORE_STRAP_PORT,IMAGE_STORE_STRAP_PIN) = PORT_PULLUPEN_bm | PORT_ISC_INTDISABLE_gc;
+  STORE::read_header();
+  STORE::STATE = STORE::header.magic == STORE::MAGIC && STORE::header.armed == 0
+    ? STORE::STORE_ARMED
+    : STORE::STORE_IDLE;
+}
+
+void STORE::set_state (uint8_t state) {
+  if (state == STORE::STORE_RECORD) {
+    /* a new recording forgets the old image */
+    STORE::erase_page(IMAGE_STORE_ADDR);
+    STORE::header.magic = ~0;
+    STORE::header.count = 0;
+    STORE::tail = STORE::RECORD_BASE;
+  }
+  else {
+    if (STORE::STATE != STORE::STORE_RECORD) STORE::read_header();
+    /* the header is written last : an interrupted recording stays invalid */
+    else if (STORE::header.count) STORE::header.magic = STORE::MAGIC;
+    if (STORE::header.magic != STORE::MAGIC) state = STORE::STORE_IDLE;
+    else {
+      /* the header page holds nothing else, so it is simply rewritten */
+      STORE::header.armed = state == STORE::STORE_ARMED ? 0 : ~0;
+      STORE::write_words(IMAGE_STORE_ADDR, (uint8_t*)&STORE::header, sizeof(STORE::header));
+    }
+  }
+  STORE::STATE = state;
+  #ifdef DEBUG_USE_USART
+  DBG::print(" STORE=", false);
+  DBG::write_hex(state);
+  #endif
+}
+
+uint16_t STORE::count (void) {
+  if (STORE::STATE == STORE::STORE_RECORD) return STORE::header.count;
+  STORE::read_header();
+  return STORE::header.magic == STORE::MAGIC ? STORE::header.count : 0;
+}
+
+/* Keep the flash page of the current CMND_WRITE_MEMORY request */
+/* Called after a successful write and before its answer : the host waits */
+/* The type and size are taken before the write : its answer overwrites them */
+void STORE::record (uint8_t mem_type, size_t byte_count) {
+  if (STORE::STATE != STORE::STORE_RECORD) return;
+  if (mem_type != JTAG2::MTYPE_FLASH_PAGE
+   && mem_type != JTAG2::MTYPE_XMEGA_FLASH
+   && mem_type != JTAG2::MTYPE_BOOT_FLASH) return;
+  if (byte_count != NVM::flash_pagesize) return;
+  if (STORE::tail + 4 + byte_count > STORE::STORE_END) {
+    /* store full : the image is incomplete, so it is not kept */
+    STORE::STATE = STORE::STORE_IDLE;
+    return;
+  }
+  if (STORE::header.count == 0) {
+    STORE::header.pagesize = byte_count;
+    STORE::header.nvmprogver = UPDI::NVMPROGVER;
+    memcpy(STORE::header.signature, UPDI::signature, sizeof(STORE::header.signature));
+  }
+  /* record : 4 bytes address, then the page data */
+  STORE::write_words(STORE::tail, &JTAG2::packet.body[6], 4);
+  STORE::write_words(STORE::tail + 4, &JTAG2::packet.body[10], byte_count);
+  STORE::tail += 4 + byte_count;
+  STORE::header.count++;
+}
+
+/* Program the stored image into the connected target */
+/* This runs without a host : the posted answers are not sent */
+bool STORE::replay (void) {
+  STORE::read_header();
+  if (STORE::header.magic != STORE::MAGIC) return false;
+  if (!UPDI::runtime(UPDI::UPDI_CMD_ENTER)) return false;
+  bool _result = false;
+  for (;;) {
+    /* only a target of the recorded family is programmed */
+    if (UPDI::NVMPROGVER != STORE::header.nvmprogver
+      || memcmp(UPDI::signature, STORE::header.signature, sizeof(STORE::header.signature)) != 0) break;
+
+    JTAG2::packet.body[1] = JTAG2::XMEGA_ERASE_CHIP;
+    *((uint32_t*)&JTAG2::packet.body[2]) = 0;
+    if (!UPDI::runtime(UPDI::UPDI_CMD_ERASE)) break;
+
+    NVM::flash_pagesize = STORE::header.pagesize;
+    uint32_t _addr = STORE::RECORD_BASE;
+    uint16_t _count = STORE::header.count;
+    do {
+      uint8_t _blank = 0xFF;
+      JTAG2::packet.body[0] = JTAG2::CMND_WRITE_MEMORY;
+      JTAG2::packet.body[1] = JTAG2::MTYPE_FLASH_PAGE;
+      *((uint32_t*)&JTAG2::packet.body[2]) = STORE::header.pagesize;
+      *((uint32_t*)&JTAG2::packet.body[6]) = pgm_read_dword_far(_addr);
+      _addr += 4;
+      for (uint16_t i = 0; i < STORE::header.pagesize; i++) {
+        _blank &= JTAG2::packet.body[10 + i] = pgm_read_byte_far(_addr++);
+      }
+      JTAG2::body_blank = _blank == 0xFF;
+      if (!UPDI::runtime(UPDI::UPDI_CMD_WRITE_MEMORY)) break;
+    } while (--_count);
+    _result = _count == 0;
+    break;
+  }
+  #ifdef DEBUG_USE_USART
+  DBG::print(_result ? "[REPLAY]" : "[REPLAY:NG]", false);
+  #endif
+  UPDI::runtime(UPDI::UPDI_CMD_TARGET_RESET);
+  return _result;
+}
+
+#endif  /* ENABLE_IMAGE_STORE */
+
+// end of code
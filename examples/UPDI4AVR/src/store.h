@@ -0,0 +1,63 @@
+/**
+ * @file store.h
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_IMAGE_STORE : a recorded session kept in the programmer flash
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include "../configuration.h"
+#include "sys.h"
+
+#if defined(ENABLE_IMAGE_STORE) && !defined(IMAGE_STORE_ADDR)
+  #error "ENABLE_IMAGE_STORE needs an AVR Dx host and IMAGE_STORE_ADDR"
+#endif
+#if defined(ENABLE_IMAGE_STORE) && !defined(IMAGE_STORE_STRAP_PORT)
+  #error "ENABLE_IMAGE_STORE needs the IMAGE_STORE_STRAP_PORT replay strap"
+#endif
+
+#ifdef ENABLE_IMAGE_STORE
+namespace STORE {
+  /* CMND_SET_PARAMETER PARAM_STORE values */
+  enum store_state_e {
+      STORE_IDLE   = 0    // recording stopped, no replay
+    , STORE_RECORD = 1    // flash page writes are kept in the store
+    , STORE_ARMED  = 2    // MAKE signal with the strap low replays the store
+  };
+
+  /* Store header : first flash page of the store area */
+  struct store_header_t {
+    uint16_t magic;
+    uint16_t pagesize;    // target flash page size
+    uint16_t count;       // recorded pages
+    uint8_t  nvmprogver;
+    uint8_t  signature[3];
+    uint16_t armed;       // 0 : replay by the MAKE signal after power on
+  };
+
+  extern uint8_t STATE;
+
+  void setup (void);
+  void set_state (uint8_t state);
+  uint16_t count (void);
+  void record (uint8_t mem_type, size_t byte_count);
+  bool replay (void);
+
+  /* true : the replay strap is tied low, no host is expected */
+  inline bool is_standalone (void) {
+    return bit_is_clear(IMAGE_STORE_STRAP_PORT.IN, IMAGE_STORE_STRAP_PIN);
+  }
+  inline bool is_recording (void) {
+    return STORE::STATE == STORE::STORE_RECORD;
+  }
+}
+#else
+namespace STORE {
+  inline bool is_recording (void) { return false; }
+}
+#endif  /* ENABLE_IMAGE_STORE */
+
+// end of code
@@ -13,7 +13,7 @@
 
 /* Local objects */
 namespace {
-  volatile uint16_t _timer_millis = 0;
+  volatile uint32_t _timer_millis = 0;
   static volatile TCB_t *_timer =
   #if defined(MILLIS_USE_TIMERB0)
     &TCB0;
@@ -61,15 +61,20 @@ void TIMER::setup (void) {
 uint16_t TIMER::millis (void) {
   uint16_t ms;
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-    ms = _timer_millis;
+    ms = (uint16_t) _timer_millis;
   }
   return ms;
 }
 
 uint16_t TIMER::micros (void) {
+  return (uint16_t) TIMER::micros32();
+}
+
+/* Wraps after 71 minutes : spans over 65ms, e.g. a chip erase */
+uint32_t TIMER::micros32 (void) {
   uint32_t ms, tc;
   ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-    ms = (uint32_t) _timer_millis;
+    ms = _timer_millis;
     tc = (uint32_t) _timer->CNT;   // ticks (0) .. (TIME_TRACKING_TIMER_COUNT - 1)
     if (bit_is_set(_timer->INTFLAGS, TCB_CAPT_bp)) {
       ms++;
@@ -31,6 +31,7 @@ namespace TIMER {
   void setup (void);
   uint16_t millis (void);
   uint16_t micros (void);
+  uint32_t micros32 (void);
   void delay(uint16_t ms);
   void delay_us(uint16_t us);
 }
@@ -17,6 +17,38 @@ namespace USART {
   uint16_t calc_baudrate_synchronous (uint32_t baudrate);
   void change_baudrate (volatile USART_t *hwserial_module, uint32_t baudrate);
   void setup (volatile USART_t *hwserial_module, uint16_t boud, uint8_t ctrl_a, uint8_t ctrl_b, uint8_t ctrl_c);
+
+  /* Byte I/O primitives of the JTAG2 and UPDI data path */
+  /* A host side build replaces these to attach a simulated link */
+  #ifdef UPDI4AVR_HOST
+  bool is_rx_ready (volatile USART_t *hwserial_module);
+  bool is_tx_ready (volatile USART_t *hwserial_module);
+  bool is_tx_complete (volatile USART_t *hwserial_module);
+  void write (volatile USART_t *hwserial_module, uint8_t data);
+  uint8_t read_status (volatile USART_t *hwserial_module);
+  uint8_t read (volatile USART_t *hwserial_module);
+  #else
+  inline bool is_rx_ready (volatile USART_t *hwserial_module) {
+    return bit_is_set((*hwserial_module).STATUS, USART_RXCIF_bp);
+  }
+  inline bool is_tx_ready (volatile USART_t *hwserial_module) {
+    return bit_is_set((*hwserial_module).STATUS, USART_DREIF_bp);
+  }
+  inline bool is_tx_complete (volatile USART_t *hwserial_module) {
+    return bit_is_set((*hwserial_module).STATUS, USART_TXCIF_bp);
+  }
+  inline void write (volatile USART_t *hwserial_module, uint8_t data) {
+    (*hwserial_module).STATUS |= USART_TXCIF_bm;
+    (*hwserial_module).TXDATAL = data;
+  }
+  /* read_status must precede read : RXDATAH is valid until RXDATAL is read */
+  inline uint8_t read_status (volatile USART_t *hwserial_module) {
+    return (*hwserial_module).RXDATAH;
+  }
+  inline uint8_t read (volatile USART_t *hwserial_module) {
+    return (*hwserial_module).RXDATAL;
+  }
+  #endif
 }
 
 // end of code
@@ -0,0 +1,213 @@
+/**
+ * @file bench.cpp
+ * @author UPDI4AVR contributors
+ * @brief Replays an avrdude jtag2updi session against a simulated target
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace BENCH {
+  struct baud_t {
+    uint32_t baud;
+    uint8_t code;
+  };
+  const baud_t baud_table[] = {
+      { 19200, 0x04 }, { 38400, 0x05 }, { 57600, 0x06 }, { 115200, 0x07 }
+    , { 230400, 0x0A }, { 460800, 0x0B }, { 921600, 0x0C }, { 500000, 0x16 }
+    , { 1000000, 0x19 }, { 1500000, 0x1A }, { 2000000, 0x1B }, { 3000000, 0x1C }
+  };
+
+  using SESSION::config;
+  using SESSION::image;
+  using SESSION::image_size;
+  uint32_t jtag_baud = 115200;
+  uint32_t updi_cap = 0;
+  uint32_t latency_us = 1000;
+  uint32_t read_size = 0;
+  uint8_t *readback;
+
+  struct phase_t {
+    uint64_t start_us, end_us;
+    SIM::stats_t start, end;
+  } write_phase, read_phase;
+
+  [[noreturn]] void check_failed (const char *what) {
+    SIM::fail("session step failed : %s", what);
+  }
+
+  void check (bool result, const char *what) {
+    if (!result) check_failed(what);
+  }
+
+  uint8_t baud_code (uint32_t baud) {
+    for (auto &b : baud_table) if (b.baud == baud) return b.code;
+    fprintf(stderr, "bench: no PARAM_BAUD_RATE code for %u\n", baud);
+    exit(2);
+  }
+
+  void begin (phase_t &phase) {
+    phase.start_us = HOST::time_us();
+    phase.start = SIM::stats;
+  }
+
+  void end (phase_t &phase) {
+    phase.end_us = HOST::time_us();
+    phase.end = SIM::stats;
+  }
+
+  void script (void) {
+    uint8_t sig[3];
+    SESSION::open(latency_us);
+    check(SESSION::sign_on(), "GET_SIGN_ON");
+    check(SESSION::set_baud(baud_code(jtag_baud), jtag_baud), "SET_PARAMETER BAUD_RATE");
+    check(SESSION::set_descriptor(config), "SET_DEVICE_DESCRIPTOR");
+    check(SESSION::enter(), "ENTER_PROGMODE");
+    check(SESSION::read_signature(config, sig), "READ_MEMORY SIGN_JTAG");
+    if (memcmp(sig, config->signature, 3) != 0) {
+      SIM::fail("signature %02X %02X %02X", sig[0], sig[1], sig[2]);
+    }
+    check(SESSION::erase(), "XMEGA_ERASE");
+
+    begin(write_phase);
+    for (uint32_t addr = 0; addr < image_size; addr += config->flash_page) {
+      check(SESSION::write_page(SESSION::MTYPE_XMEGA_FLASH,
+        config->flash_base + addr, &image[addr], config->flash_page), "WRITE_MEMORY");
+    }
+    end(write_phase);
+
+    if (read_size > 512) {
+      uint8_t value[2] = { (uint8_t) read_size, (uint8_t)(read_size >> 8) };
+      check(SESSION::set_param(SESSION::PARAM_MAX_FRAME, value, 2), "SET_PARAMETER MAX_FRAME");
+    }
+    begin(read_phase);
+    for (uint32_t addr = 0; addr < image_size; addr += read_size) {
+      uint32_t len = image_size - addr < read_size ? image_size - addr : read_size;
+      check(SESSION::read_block(SESSION::MTYPE_FLASH_PAGE,
+        config->flash_base + addr, &readback[addr], len), "READ_MEMORY");
+    }
+    end(read_phase);
+
+    check(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+
+  double rate (const phase_t &phase) {
+    uint64_t span = phase.end_us - phase.start_us;
+    return span ? image_size * 1e6 / span : 0;
+  }
+
+  double symbols_per_page (const phase_t &phase) {
+    uint32_t pages = image_size / config->flash_page;
+    uint32_t symbols = (phase.end.updi_out - phase.start.updi_out)
+                     + (phase.end.updi_in - phase.start.updi_in);
+    return pages ? (double) symbols / pages : 0;
+  }
+
+  const char *command_name (uint8_t id) {
+    switch (id) {
+      case SESSION::CMND_SIGN_OFF               : return "SIGN_OFF";
+      case SESSION::CMND_GET_SIGN_ON            : return "GET_SIGN_ON";
+      case SESSION::CMND_SET_PARAMETER          : return "SET_PARAMETER";
+      case SESSION::CMND_GET_PARAMETER          : return "GET_PARAMETER";
+      case SESSION::CMND_WRITE_MEMORY           : return "WRITE_MEMORY";
+      case SESSION::CMND_READ_MEMORY            : return "READ_MEMORY";
+      case SESSION::CMND_GO                     : return "GO";
+      case SESSION::CMND_RESET                  : return "RESET";
+      case SESSION::CMND_SET_DEVICE_DESCRIPTOR  : return "SET_DEVICE_DESCRIPTOR";
+      case SESSION::CMND_GET_SYNC               : return "GET_SYNC";
+      case SESSION::CMND_ENTER_PROGMODE         : return "ENTER_PROGMODE";
+      case SESSION::CMND_LEAVE_PROGMODE         : return "LEAVE_PROGMODE";
+      case SESSION::CMND_XMEGA_ERASE            : return "XMEGA_ERASE";
+      default                                   : return "?";
+    }
+  }
+
+  void report (void) {
+    printf("target   %s (%s) NVMCTRL v%c, page %u\n",
+      config->name, config->part, TARGET::nvm_version(), config->flash_page);
+    printf("jtag     %u bps, latency %u us\n", jtag_baud, latency_us);
+    printf("write    %u bytes %9.3f ms %9.0f bytes/s %7.1f UPDI symbols/page\n",
+      image_size, (write_phase.end_us - write_phase.start_us) / 1000.0,
+      rate(write_phase), symbols_per_page(write_phase));
+    printf("read     %u bytes %9.3f ms %9.0f bytes/s %7.1f UPDI symbols/page (block %u)\n",
+      image_size, (read_phase.end_us - read_phase.start_us) / 1000.0,
+      rate(read_phase), symbols_per_page(read_phase), read_size);
+    printf("updi     %u out, %u in, %u breaks, %u collisions, %u target errors\n",
+      SIM::stats.updi_out, SIM::stats.updi_in, SIM::stats.updi_breaks,
+      SIM::stats.updi_collisions, TARGET::updi_errors);
+    printf("%-22s %6s %10s %10s %10s\n", "command", "count", "min us", "avg us", "max us");
+    for (int id = 0; id < 256; id++) {
+      SESSION::latency_t &l = SESSION::latency[id];
+      if (l.count == 0) continue;
+      printf("%-22s %6u %10llu %10llu %10llu\n", command_name(id), l.count,
+        (unsigned long long) l.min_us, (unsigned long long)(l.total_us / l.count),
+        (unsigned long long) l.max_us);
+    }
+  }
+
+  void usage (void) {
+    fprintf(stderr,
+      "usage: bench [-t target] [-b jtag_baud] [-u updi_max_baud] [-l latency_us]\n"
+      "             [-s image_size] [-r read_block]\n"
+      "targets: mega0 tiny2 dx ea du\n");
+    exit(2);
+  }
+}
+
+int main (int argc, char *argv[]) {
+  using namespace BENCH;
+  const char *name = "dx";
+  uint32_t size = 0x4000;
+  int opt;
+  while ((opt = getopt(argc, argv, "t:b:u:l:s:r:")) != -1) {
+    switch (opt) {
+      case 't' : name = optarg; break;
+      case 'b' : jtag_baud = strtoul(optarg, nullptr, 0); break;
+      case 'u' : updi_cap = strtoul(optarg, nullptr, 0); break;
+      case 'l' : latency_us = strtoul(optarg, nullptr, 0); break;
+      case 's' : size = strtoul(optarg, nullptr, 0); break;
+      case 'r' : read_size = strtoul(optarg, nullptr, 0); break;
+      default  : usage();
+    }
+  }
+  if ((config = TARGET::find(name)) == nullptr) usage();
+  if (size > config->flash_size) size = config->flash_size;
+  size -= size % config->flash_page;
+  if (read_size == 0) read_size = config->flash_page;
+  TARGET::setup(config, updi_cap);
+  SESSION::make_image(size, 0xC0FFEE);
+  readback = (uint8_t*) malloc(image_size);
+
+  SIM::run(script);
+
+  report();
+  int result = 0;
+  if (memcmp(readback, image, image_size) != 0) {
+    printf("FAIL read back differs from the image\n");
+    result = 1;
+  }
+  if (memcmp(TARGET::flash(), image, image_size) != 0) {
+    printf("FAIL target flash differs from the image\n");
+    result = 1;
+  }
+  if (TARGET::nvm_errors || SIM::stats.updi_collisions) {
+    printf("FAIL %u NVM sequence errors, %u UPDI collisions\n",
+      TARGET::nvm_errors, SIM::stats.updi_collisions);
+    result = 1;
+  }
+  if (result == 0) printf("PASS\n");
+  return result;
+}
+
+// end of code
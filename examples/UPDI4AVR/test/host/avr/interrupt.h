@@ -0,0 +1,20 @@
+/**
+ * @file interrupt.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <avr/interrupt.h> : the global interrupt flag is simulated
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <avr/io.h>
+
+/* Vectors are plain C functions the simulator dispatches */
+#define ISR(vector) extern "C" void vector (void); void vector (void)
+#define sei() (SIM::SREG_I = 1)
+#define cli() (SIM::SREG_I = 0)
+#define reti() (SIM::SREG_I = 1)
+
+// end of code
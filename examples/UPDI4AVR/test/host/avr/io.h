@@ -0,0 +1,247 @@
+/**
+ * @file io.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <avr/io.h> : AVR128DB32 registers as plain memory
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/* Simulator hooks : a polled register read lets the simulated time run */
+namespace SIM {
+  void poll (void);
+  extern volatile uint8_t SREG_I;
+}
+
+#define _BV(bit) (1 << (bit))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { SIM::poll(); } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { SIM::poll(); } while (bit_is_set(sfr, bit))
+#define _PROTECTED_WRITE(reg, value) ((reg) = (value))
+#define _PROTECTED_WRITE_SPM(reg, value) ((reg) = (value))
+
+#define FLASHEND  0x1FFFF
+#define RAMSTART  0x4000
+#define RAMEND    0x7FFF
+#define INTERNAL_SRAM_SIZE (RAMEND - RAMSTART + 1)
+#define MAPPED_PROGMEM_START 0x8000
+
+typedef struct USART_struct {
+  volatile uint8_t RXDATAL;
+  volatile uint8_t RXDATAH;
+  volatile uint8_t TXDATAL;
+  volatile uint8_t TXDATAH;
+  volatile uint8_t STATUS;
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t CTRLC;
+  volatile uint16_t BAUD;
+  volatile uint8_t CTRLD;
+  volatile uint8_t DBGCTRL;
+  volatile uint8_t EVCTRL;
+  volatile uint8_t TXPLCTRL;
+  volatile uint8_t RXPLCTRL;
+  volatile uint8_t reserved_1;
+} USART_t;
+
+typedef struct PORT_struct {
+  volatile uint8_t DIR;
+  volatile uint8_t DIRSET;
+  volatile uint8_t DIRCLR;
+  volatile uint8_t DIRTGL;
+  volatile uint8_t OUT;
+  volatile uint8_t OUTSET;
+  volatile uint8_t OUTCLR;
+  volatile uint8_t OUTTGL;
+  volatile uint8_t IN;
+  volatile uint8_t INTFLAGS;
+  volatile uint8_t PORTCTRL;
+  volatile uint8_t PINCONFIG;
+  volatile uint8_t PINCTRLUPD;
+  volatile uint8_t PINCTRLSET;
+  volatile uint8_t PINCTRLCLR;
+  volatile uint8_t reserved_1;
+  volatile uint8_t PIN0CTRL;
+  volatile uint8_t PIN1CTRL;
+  volatile uint8_t PIN2CTRL;
+  volatile uint8_t PIN3CTRL;
+  volatile uint8_t PIN4CTRL;
+  volatile uint8_t PIN5CTRL;
+  volatile uint8_t PIN6CTRL;
+  volatile uint8_t PIN7CTRL;
+} PORT_t;
+
+typedef struct TCB_struct {
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t reserved_1[2];
+  volatile uint8_t EVCTRL;
+  volatile uint8_t INTCTRL;
+  volatile uint8_t INTFLAGS;
+  volatile uint8_t STATUS;
+  volatile uint8_t DBGCTRL;
+  volatile uint8_t TEMP;
+  volatile uint16_t CNT;
+  volatile uint16_t CCMP;
+} TCB_t;
+
+typedef struct TCA_SPLIT_struct {
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t CTRLC;
+  volatile uint8_t CTRLD;
+  volatile uint8_t LPER;
+  volatile uint8_t HPER;
+  volatile uint8_t LCMP0;
+  volatile uint8_t LCMP1;
+  volatile uint8_t LCMP2;
+  volatile uint8_t HCMP0;
+  volatile uint8_t HCMP1;
+  volatile uint8_t HCMP2;
+} TCA_SPLIT_t;
+
+typedef union TCA_union {
+  TCA_SPLIT_t SPLIT;
+} TCA_t;
+
+typedef struct PORTMUX_struct {
+  volatile uint8_t USARTROUTEA;
+  volatile uint8_t TCAROUTEA;
+} PORTMUX_t;
+
+typedef struct RSTCTRL_struct {
+  volatile uint8_t RSTFR;
+  volatile uint8_t SWRR;
+} RSTCTRL_t;
+
+typedef struct NVMCTRL_struct {
+  volatile uint8_t CTRLA;
+  volatile uint8_t CTRLB;
+  volatile uint8_t STATUS;
+  volatile uint8_t INTCTRL;
+  volatile uint8_t INTFLAGS;
+} NVMCTRL_t;
+
+typedef struct FUSE_struct {
+  volatile uint8_t OSCCFG;
+} FUSE_t;
+
+typedef struct SIGROW_struct {
+  volatile int8_t OSC16ERR5V;
+  volatile int8_t OSC20ERR5V;
+} SIGROW_t;
+
+extern USART_t USART0, USART1, USART2;
+extern PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+extern TCB_t TCB0, TCB1, TCB2;
+extern TCA_t TCA0;
+extern PORTMUX_t PORTMUX;
+extern RSTCTRL_t RSTCTRL;
+extern NVMCTRL_t NVMCTRL;
+extern FUSE_t FUSE;
+extern SIGROW_t SIGROW;
+extern volatile uint8_t RAMPZ;
+extern volatile uint16_t SP;
+extern volatile uint8_t WDT_CTRLA;
+extern volatile uint8_t WDT_STATUS;
+extern volatile uint8_t CLKCTRL_OSCHFCTRLA;
+extern volatile uint8_t CLKCTRL_MCLKCTRLB;
+extern volatile uint8_t SIGROW_SERNUM[16];
+
+#define USART0 USART0
+#define USART1 USART1
+#define USART2 USART2
+#define PORTA PORTA
+#define PORTB PORTB
+#define PORTC PORTC
+#define PORTD PORTD
+#define PORTE PORTE
+#define PORTF PORTF
+
+/* The serial number is one array : JTAG2::sign_on walks it by pointer */
+#define SIGROW_SERNUM0  SIGROW_SERNUM[0]
+#define SIGROW_SERNUM4  SIGROW_SERNUM[4]
+#define SIGROW_SERNUM10 SIGROW_SERNUM[10]
+#define SIGROW_SERNUM15 SIGROW_SERNUM[15]
+
+enum {
+    USART_RXCIF_bm = 0x80, USART_RXCIF_bp = 7
+  , USART_TXCIF_bm = 0x40, USART_TXCIF_bp = 6
+  , USART_DREIF_bm = 0x20, USART_DREIF_bp = 5
+  , USART_BUFOVF_bm = 0x40
+  , USART_FERR_bm = 0x04
+  , USART_PERR_bm = 0x02
+  , USART_RXCIE_bm = 0x80
+  , USART_TXCIE_bm = 0x40
+  , USART_DREIE_bm = 0x20
+  , USART_LBME_bm = 0x08
+  , USART_RXEN_bm = 0x80
+  , USART_TXEN_bm = 0x40
+  , USART_ODME_bm = 0x08
+  , USART_RXMODE_NORMAL_gc = 0x00
+  , USART_RXMODE_CLK2X_gc = 0x02
+  , USART_CMODE_ASYNCHRONOUS_gc = 0x00
+  , USART_CMODE_MSPI_gc = 0xC0
+  , USART_PMODE_DISABLED_gc = 0x00
+  , USART_PMODE_EVEN_gc = 0x20
+  , USART_PMODE_gm = 0x30
+  , USART_SBMODE_1BIT_gc = 0x00
+  , USART_SBMODE_2BIT_gc = 0x08
+  , USART_CHSIZE_8BIT_gc = 0x03
+};
+
+enum {
+    PORT_INVEN_bm = 0x80
+  , PORT_PULLUPEN_bm = 0x08
+  , PORT_ISC_gm = 0x07
+  , PORT_ISC_INTDISABLE_gc = 0x00
+  , PORT_ISC_BOTHEDGES_gc = 0x01
+  , PORT_ISC_RISING_gc = 0x02
+  , PORT_ISC_FALLING_gc = 0x03
+  , PORT_ISC_INPUT_DISABLE_gc = 0x04
+  , PORT_ISC_LEVEL_gc = 0x05
+};
+
+enum {
+    TCB_ENABLE_bm = 0x01
+  , TCB_CAPT_bm = 0x01, TCB_CAPT_bp = 0
+  , TCB_CNTMODE_INT_gc = 0x00
+  , CLKCTRL_PDIV0_bm = 0x02
+  , TCA_SPLIT_ENABLE_bm = 0x01
+  , TCA_SPLIT_CLKSEL_DIV4_gc = 0x04
+  , TCA_SPLIT_SPLITM_bm = 0x01
+  , TCA_SPLIT_LCMP0EN_bm = 0x01
+  , TCA_SPLIT_LCMP1EN_bm = 0x02
+  , TCA_SPLIT_LCMP2EN_bm = 0x04
+  , TCA_SPLIT_HCMP0EN_bm = 0x10
+  , TCA_SPLIT_HCMP1EN_bm = 0x20
+  , TCA_SPLIT_HCMP2EN_bm = 0x40
+  , PORTMUX_TCA0_PORTA_gc = 0x00
+  , PORTMUX_TCA0_PORTB_gc = 0x01
+  , PORTMUX_TCA0_PORTC_gc = 0x02
+  , PORTMUX_TCA0_PORTD_gc = 0x03
+  , PORTMUX_TCA0_PORTE_gc = 0x04
+  , PORTMUX_TCA0_PORTF_gc = 0x05
+  , PORTMUX_USART2_DEFAULT_gc = 0x00
+  , PORTMUX_USART2_ALT1_gc = 0x10
+  , RSTCTRL_SWRE_bm = 0x01
+  , WDT_SYNCBUSY_bp = 0
+  , WDT_PERIOD_OFF_gc = 0x00
+  , WDT_PERIOD_64CLK_gc = 0x01
+  , FUSE_FREQSEL_gm = 0x03
+  , NVMCTRL_FBUSY_bm = 0x01
+  , NVMCTRL_CMD_NONE_gc = 0x00
+  , NVMCTRL_CMD_NOOP_gc = 0x01
+  , NVMCTRL_CMD_FLWR_gc = 0x02
+  , NVMCTRL_CMD_FLPER_gc = 0x08
+};
+
+#define RSTCTRL_SWRE_bm RSTCTRL_SWRE_bm
+
+// end of code
@@ -0,0 +1,25 @@
+/**
+ * @file pgmspace.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <avr/pgmspace.h>
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define memcpy_P memcpy
+
+/* Far reads address the simulated host flash */
+uint8_t pgm_read_byte_far (uint32_t addr);
+uint16_t pgm_read_word_far (uint32_t addr);
+uint32_t pgm_read_dword_far (uint32_t addr);
+
+// end of code
@@ -0,0 +1,13 @@
+/**
+ * @file sleep.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <avr/sleep.h>
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+
+// end of code
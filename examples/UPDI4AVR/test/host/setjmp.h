@@ -0,0 +1,19 @@
+/**
+ * @file setjmp.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <setjmp.h> : longjmp restores the interrupt flag as avr-libc does
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include_next <setjmp.h>
+#include <avr/io.h>
+
+/* avr-libc saves SREG in jmp_buf : leaving an ISR by longjmp enables interrupts again */
+/* every setjmp of the firmware runs with interrupts enabled */
+#define longjmp(env, val) (SIM::SREG_I = 1, longjmp(env, val))
+
+// end of code
@@ -0,0 +1,32 @@
+/**
+ * @file atomic.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <util/atomic.h> : masks the simulated interrupts
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+#define NONATOMIC_RESTORESTATE 0
+#define NONATOMIC_FORCEOFF 1
+
+namespace SIM {
+  /* Saves the flag, masks, and lets pending vectors run on exit */
+  struct atomic_guard {
+    uint8_t sreg, once;
+    atomic_guard (bool on) : sreg(SREG_I), once(1) { SREG_I = on; }
+    ~atomic_guard () { SREG_I = sreg; if (sreg) poll(); }
+  };
+}
+
+#define ATOMIC_BLOCK(type) for (SIM::atomic_guard _guard(false); _guard.once; _guard.once = 0)
+#define NONATOMIC_BLOCK(type) for (SIM::atomic_guard _guard(true); _guard.once; _guard.once = 0)
+
+// end of code
@@ -0,0 +1,20 @@
+/**
+ * @file crc16.h
+ * @author UPDI4AVR contributors
+ * @brief Host side <util/crc16.h> : the avr-libc reference formula
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update (uint16_t crc, uint8_t data) {
+  data ^= crc & 0xFF;
+  data ^= data << 4;
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+// end of code
@@ -0,0 +1,287 @@
+/**
+ * @file session.cpp
+ * @author UPDI4AVR contributors
+ * @brief JTAG2 host side of an avrdude session for the simulator
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "session.h"
+
+namespace SESSION {
+  latency_t latency[256];
+  uint8_t answer[8192];
+  size_t answer_size;
+  uint16_t sequence;
+  uint8_t request[8192];
+  const TARGET::config_t *config;
+  uint32_t errors;
+  uint8_t *image;
+  uint32_t image_size;
+}
+
+/* Bitwise CRC-CCITT, independent of the firmware table */
+uint16_t SESSION::crc16 (const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t i = 0; i < 8; i++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : (crc >> 1);
+    }
+  }
+  return crc;
+}
+
+size_t SESSION::frame (uint8_t *out, uint16_t seq, const uint8_t *body, size_t len) {
+  out[0] = 0x1B;
+  out[1] = seq;
+  out[2] = seq >> 8;
+  out[3] = len;
+  out[4] = len >> 8;
+  out[5] = len >> 16;
+  out[6] = len >> 24;
+  out[7] = 0x0E;
+  memcpy(&out[8], body, len);
+  uint16_t crc = crc16(out, len + 8);
+  out[len + 8] = crc;
+  out[len + 9] = crc >> 8;
+  return len + 10;
+}
+
+/* PackBits (TIFF) : a run of three or more is a repeat, the rest literals */
+size_t SESSION::pack (uint8_t *out, const uint8_t *data, size_t len) {
+  size_t i = 0, o = 0;
+  while (i < len) {
+    size_t run = 1;
+    while (i + run < len && run < 128 && data[i + run] == data[i]) run++;
+    if (run >= 3) {
+      out[o++] = 257 - run;
+      out[o++] = data[i];
+      i += run;
+      continue;
+    }
+    size_t start = i, n = 0;
+    while (i < len && n < 128) {
+      if (i + 2 < len && data[i] == data[i + 1] && data[i] == data[i + 2]) break;
+      i++;
+      n++;
+    }
+    out[o++] = n - 1;
+    memcpy(&out[o], &data[start], n);
+    o += n;
+  }
+  return o;
+}
+
+void SESSION::send_frame (const uint8_t *body, size_t len) {
+  size_t size = frame(request, ++sequence, body, len);
+  HOST::send(request, size);
+}
+
+bool SESSION::receive_frame (uint32_t timeout_ms) {
+  uint8_t header[8];
+  int c;
+  uint64_t limit = HOST::time_us() + (uint64_t) timeout_ms * 1000;
+  auto next = [&] (void) -> int {
+    uint64_t t = HOST::time_us();
+    return t < limit ? HOST::recv(limit - t) : -1;
+  };
+  for (;;) {
+    do {
+      if ((c = next()) < 0) return false;
+    } while (c != 0x1B);
+    header[0] = c;
+    for (int i = 1; i < 8; i++) {
+      if ((c = next()) < 0) return false;
+      header[i] = c;
+    }
+    if (header[7] != 0x0E) continue;
+    uint32_t size = header[3] | (header[4] << 8) | (header[5] << 16) | ((uint32_t) header[6] << 24);
+    if (size + 2 > sizeof(answer) - 8) continue;
+    static uint8_t raw[sizeof(answer) + 10];
+    memcpy(raw, header, 8);
+    for (uint32_t i = 0; i < size + 2; i++) {
+      if ((c = next()) < 0) return false;
+      raw[8 + i] = c;
+    }
+    if (crc16(raw, size + 10) != 0) {
+      fprintf(stderr, "session: answer CRC error\n");
+      return false;
+    }
+    if ((uint16_t)(header[1] | (header[2] << 8)) != sequence) {
+      fprintf(stderr, "session: answer out of sequence\n");
+      return false;
+    }
+    memcpy(answer, &raw[8], size);
+    answer_size = size;
+    return true;
+  }
+}
+
+bool SESSION::command (const uint8_t *body, size_t len, uint32_t timeout_ms) {
+  uint64_t start = HOST::time_us();
+  send_frame(body, len);
+  answer_size = 0;
+  if (!receive_frame(timeout_ms)) return false;
+  uint64_t span = HOST::time_us() - start;
+  latency_t &l = latency[body[0]];
+  if (l.count == 0 || span < l.min_us) l.min_us = span;
+  if (span > l.max_us) l.max_us = span;
+  l.total_us += span;
+  l.count++;
+  return true;
+}
+
+uint8_t SESSION::command_code (const uint8_t *body, size_t len) {
+  return command(body, len) && answer_size ? answer[0] : 0;
+}
+
+/* The port opens at 19200 bps and DTR/RTS pull the MAKE input low */
+void SESSION::open (uint32_t latency_us) {
+  HOST::set_latency(latency_us);
+  HOST::set_baud(19200);
+  HOST::set_make(true);
+  HOST::wait_us(1000);
+}
+
+bool SESSION::sign_on (void) {
+  const uint8_t body[] = { CMND_GET_SIGN_ON };
+  return command_code(body, sizeof(body)) == RSP_SIGN_ON;
+}
+
+bool SESSION::set_param (uint8_t id, const uint8_t *value, size_t len) {
+  uint8_t body[8] = { CMND_SET_PARAMETER, id };
+  memcpy(&body[2], value, len);
+  return command_code(body, len + 2) == RSP_OK;
+}
+
+/* The value follows RSP_PARAMETER at answer[1] */
+bool SESSION::get_param (uint8_t id) {
+  const uint8_t body[] = { CMND_GET_PARAMETER, id };
+  return command_code(body, sizeof(body)) == RSP_PARAMETER;
+}
+
+/* The new rate applies once the answer has been received */
+bool SESSION::set_baud (uint8_t code, uint32_t baud) {
+  if (!set_param(PARAM_BAUD_RATE, &code, 1)) return false;
+  HOST::set_baud(baud);
+  return true;
+}
+
+bool SESSION::set_descriptor (const TARGET::config_t *config) {
+  static uint8_t body[0x124];
+  memset(body, 0, sizeof(body));
+  body[0] = CMND_SET_DEVICE_DESCRIPTOR;
+  body[0xF4] = config->flash_page;
+  body[0xF5] = config->flash_page >> 8;
+  body[0xF6] = config->eeprom_page;
+  body[0xFD] = config->flash_size;
+  body[0xFE] = config->flash_size >> 8;
+  body[0xFF] = config->flash_size >> 16;
+  body[0x100] = config->flash_size >> 24;
+  return command_code(body, sizeof(body)) == RSP_OK;
+}
+
+bool SESSION::enter (void) {
+  const uint8_t sync[] = { CMND_GET_SYNC };
+  const uint8_t reset[] = { CMND_RESET, 0x01 };
+  const uint8_t enter[] = { CMND_ENTER_PROGMODE };
+  return command_code(sync, sizeof(sync)) == RSP_OK
+      && command_code(reset, sizeof(reset)) == RSP_OK
+      && command_code(enter, sizeof(enter)) == RSP_OK;
+}
+
+bool SESSION::read_signature (const TARGET::config_t *config, uint8_t *sig) {
+  return read_block(MTYPE_SIGN_JTAG, config->sigrow, sig, 3);
+}
+
+bool SESSION::erase (void) {
+  const uint8_t body[] = { CMND_XMEGA_ERASE, 0x00, 0, 0, 0, 0 };
+  return command_code(body, sizeof(body)) == RSP_OK;
+}
+
+bool SESSION::write_page (uint8_t mtype, uint32_t addr, const uint8_t *data, size_t len) {
+  static uint8_t body[8192];
+  body[0] = CMND_WRITE_MEMORY;
+  body[1] = mtype;
+  memcpy(&body[2], &len, 4);
+  memcpy(&body[6], &addr, 4);
+  memcpy(&body[10], data, len);
+  return command_code(body, len + 10) == RSP_OK;
+}
+
+/* MTYPE_PACKED : body[2] the expanded size, body[10] the real type */
+bool SESSION::write_packed (uint8_t mtype, uint32_t addr, const uint8_t *data, size_t len) {
+  static uint8_t body[8192];
+  body[0] = CMND_WRITE_MEMORY;
+  body[1] = MTYPE_PACKED;
+  memcpy(&body[2], &len, 4);
+  memcpy(&body[6], &addr, 4);
+  body[10] = mtype;
+  size_t size = pack(&body[11], data, len);
+  return command_code(body, size + 11) == RSP_OK;
+}
+
+bool SESSION::read_block (uint8_t mtype, uint32_t addr, uint8_t *data, size_t len) {
+  uint8_t body[10] = { CMND_READ_MEMORY, mtype };
+  memcpy(&body[2], &len, 4);
+  memcpy(&body[6], &addr, 4);
+  if (command_code(body, sizeof(body)) != RSP_MEMORY || answer_size != len + 1) return false;
+  memcpy(data, &answer[1], len);
+  return true;
+}
+
+bool SESSION::leave (void) {
+  const uint8_t leave[] = { CMND_LEAVE_PROGMODE };
+  const uint8_t go[] = { CMND_GO };
+  const uint8_t off[] = { CMND_SIGN_OFF };
+  return command_code(leave, sizeof(leave)) == RSP_OK
+      && command_code(go, sizeof(go)) == RSP_OK
+      && command_code(off, sizeof(off)) == RSP_OK;
+}
+
+void SESSION::close (void) {
+  HOST::wait_us(1000);
+  HOST::set_make(false);
+}
+
+void SESSION::expect (bool result, const char *what) {
+  if (result) return;
+  printf("FAIL %s\n", what);
+  errors++;
+}
+
+/* After a chip erase the blank pages are skipped */
+void SESSION::make_image (uint32_t size, uint32_t seed, uint8_t (*shape)(uint32_t, uint8_t)) {
+  uint32_t x = seed;
+  image_size = size;
+  image = (uint8_t*) malloc(size);
+  for (uint32_t i = 0; i < size; i++) {
+    x = x * 1103515245 + 12345;
+    uint8_t r = x >> 24;
+    if (shape) image[i] = shape(i, r);
+    else image[i] = ((i / config->flash_page) % 8 == 7) ? 0xFF : r;
+  }
+}
+
+void SESSION::start (void) {
+  open(100);
+  expect(sign_on(), "GET_SIGN_ON");
+  expect(set_baud(0x0B, 460800), "SET_PARAMETER BAUD_RATE");
+  expect(set_descriptor(config), "SET_DEVICE_DESCRIPTOR");
+  expect(enter(), "ENTER_PROGMODE");
+}
+
+int SESSION::finish (void) {
+  expect(TARGET::nvm_errors == 0 && SIM::stats.updi_collisions == 0, "NVM sequence errors or UPDI collisions");
+  if (errors) return 1;
+  printf("PASS\n");
+  return 0;
+}
+
+// end of code
@@ -0,0 +1,107 @@
+/**
+ * @file session.h
+ * @author UPDI4AVR contributors
+ * @brief JTAG2 host side of an avrdude session for the simulator
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "target.h"
+
+namespace SESSION {
+  /* Command IDs and answers of AVR067, as avrdude sends them */
+  enum {
+      CMND_SIGN_OFF         = 0x00
+    , CMND_GET_SIGN_ON      = 0x01
+    , CMND_SET_PARAMETER    = 0x02
+    , CMND_GET_PARAMETER    = 0x03
+    , CMND_WRITE_MEMORY     = 0x04
+    , CMND_READ_MEMORY      = 0x05
+    , CMND_GO               = 0x08
+    , CMND_RESET            = 0x0B
+    , CMND_SET_DEVICE_DESCRIPTOR = 0x0C
+    , CMND_GET_SYNC         = 0x0F
+    , CMND_ENTER_PROGMODE   = 0x14
+    , CMND_LEAVE_PROGMODE   = 0x15
+    , CMND_XMEGA_ERASE      = 0x34
+    , RSP_OK                = 0x80
+    , RSP_PARAMETER         = 0x81
+    , RSP_MEMORY            = 0x82
+    , RSP_SIGN_ON           = 0x86
+    , RSP_FAILED            = 0xA0
+    , RSP_ILLEGAL_MEMORY_RANGE = 0xA3
+    , RSP_ILLEGAL_MCU_STATE = 0xA5
+    , RSP_ILLEGAL_VALUE     = 0xA6
+    , PARAM_EMU_MODE        = 0x03
+    , PARAM_BAUD_RATE       = 0x05
+    , PARAM_UPDI_BAUD       = 0xE0
+    , PARAM_PROFILE         = 0xE1
+    , PARAM_MAX_FRAME       = 0xE2
+    , PARAM_GANG            = 0xE3
+    , PARAM_STORE           = 0xE5
+    , MTYPE_FLASH_PAGE      = 0xB0
+    , MTYPE_EEPROM_PAGE     = 0xB1
+    , MTYPE_SIGN_JTAG       = 0xB4
+    , MTYPE_XMEGA_FLASH     = 0xC0
+    , MTYPE_PACKED          = 0xE0
+  };
+
+  /* Round trip time of each command ID */
+  struct latency_t {
+    uint32_t count;
+    uint64_t min_us, max_us, total_us;
+  };
+  extern latency_t latency[256];
+
+  extern uint8_t answer[8192];
+  extern size_t answer_size;
+
+  uint16_t crc16 (const uint8_t *data, size_t len);
+  size_t frame (uint8_t *out, uint16_t seq, const uint8_t *body, size_t len);
+  size_t pack (uint8_t *out, const uint8_t *data, size_t len);
+
+  /* Raw frame I/O : the session helpers below are built on these */
+  void send_frame (const uint8_t *body, size_t len);
+  bool receive_frame (uint32_t timeout_ms = 15000);
+
+  /* One request and its answer : false on a timeout, a CRC or sequence error */
+  bool command (const uint8_t *body, size_t len, uint32_t timeout_ms = 15000);
+  uint8_t command_code (const uint8_t *body, size_t len);
+
+  /* The avrdude jtag2updi steps */
+  void open (uint32_t latency_us);
+  bool sign_on (void);
+  bool set_baud (uint8_t code, uint32_t baud);
+  bool set_param (uint8_t id, const uint8_t *value, size_t len);
+  bool get_param (uint8_t id);
+  bool set_descriptor (const TARGET::config_t *config);
+  bool enter (void);
+  bool read_signature (const TARGET::config_t *config, uint8_t *sig);
+  bool erase (void);
+  bool write_page (uint8_t mtype, uint32_t addr, const uint8_t *data, size_t len);
+  bool write_packed (uint8_t mtype, uint32_t addr, const uint8_t *data, size_t len);
+  bool read_block (uint8_t mtype, uint32_t addr, uint8_t *data, size_t len);
+  bool leave (void);
+  void close (void);
+
+  /* Test fixture : the target under test, failed expectations and a flash image */
+  extern const TARGET::config_t *config;
+  extern uint32_t errors;
+  extern uint8_t *image;
+  extern uint32_t image_size;
+
+  void expect (bool result, const char *what);
+  /* shape (index, random) : the default is random data with a blank page in every eight */
+  void make_image (uint32_t size, uint32_t seed, uint8_t (*shape)(uint32_t, uint8_t) = nullptr);
+  /* open, sign on at 460800 bps, descriptor and ENTER_PROGMODE */
+  void start (void);
+  /* exit code : no failed expectation, NVM sequence error or UPDI collision */
+  int finish (void);
+}
+
+// end of code
@@ -0,0 +1,618 @@
+/**
+ * @file sim.cpp
+ * @author UPDI4AVR contributors
+ * @brief Host side simulator : virtual clock, USART links and vectors
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <setjmp.h>
+#include <ucontext.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "sim.h"
+#include "target.h"
+
+/* Firmware entry and vectors */
+int fw_main (void);
+extern "C" void TCB1_INT_vect (void);
+extern "C" void USART0_RXC_vect (void);
+extern "C" void PORTF_PORT_vect (void);
+
+namespace TIMER {
+  void setup (void);
+  uint16_t millis (void);
+  uint16_t micros (void);
+  uint32_t micros32 (void);
+  void delay (uint16_t ms);
+  void delay_us (uint16_t us);
+}
+
+namespace USART {
+  bool is_rx_ready (volatile USART_t *hwserial_module);
+  bool is_tx_ready (volatile USART_t *hwserial_module);
+  bool is_tx_complete (volatile USART_t *hwserial_module);
+  void write (volatile USART_t *hwserial_module, uint8_t data);
+  uint8_t read_status (volatile USART_t *hwserial_module);
+  uint8_t read (volatile USART_t *hwserial_module);
+}
+
+namespace STORE {
+  void spm_word (uint32_t addr, uint16_t data);
+}
+
+/* Register file of the AVR128DB32 programmer */
+USART_t USART0, USART1, USART2;
+PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+TCB_t TCB0, TCB1, TCB2;
+TCA_t TCA0;
+PORTMUX_t PORTMUX;
+RSTCTRL_t RSTCTRL;
+NVMCTRL_t NVMCTRL;
+FUSE_t FUSE;
+SIGROW_t SIGROW;
+volatile uint8_t RAMPZ;
+volatile uint16_t SP;
+volatile uint8_t WDT_CTRLA;
+volatile uint8_t WDT_STATUS;
+volatile uint8_t CLKCTRL_OSCHFCTRLA;
+volatile uint8_t CLKCTRL_MCLKCTRLB;
+volatile uint8_t SIGROW_SERNUM[16] = {
+  0x55, 0x50, 0x44, 0x49, 0x34, 0x41, 0x56, 0x52,
+  0x2D, 0x53, 0x49, 0x4D, 0x00, 0x01, 0x02, 0x03
+};
+
+namespace SIM {
+  volatile uint8_t SREG_I;
+  tick_t now;
+  stats_t stats;
+  uint8_t host_flash[0x20000];
+
+  constexpr tick_t NEVER = ~(tick_t)0;
+  /* A polled register read costs about 12 clocks */
+  constexpr tick_t POLL_TICKS = 12 * 8;
+  constexpr tick_t MILLI_TICKS = 1000L * TICKS_PER_US;
+  constexpr uint8_t TRST_BIT = _BV(1);
+  constexpr uint8_t MAKE_BIT = _BV(6);
+  constexpr uint8_t STRAP_BIT = _BV(5);
+
+  /* One USART : shift register, one byte transmit buffer, two byte receive FIFO */
+  struct link_t {
+    volatile USART_t *reg;
+    bool shifting, full, txc, bad;
+    uint8_t tx_data, buf_data;
+    tick_t tx_start, tx_end, tx_bit;
+    uint8_t fifo[2], fstat[2], count;
+    uint8_t line;             /* UPDI line of the module */
+  } jtag, updi[UPDI_LINES];
+
+  /* A frame on a wire that is not driven by the firmware */
+  struct frame_t {
+    tick_t start, end, bit;
+    uint8_t data;
+    bool bad;
+  };
+  constexpr size_t QUEUE_SIZE = 16384;
+  struct queue_t {
+    frame_t item[QUEUE_SIZE];
+    size_t head, count;
+    tick_t line_free;
+    frame_t &front (void) { return item[head]; }
+    frame_t &at (size_t i) { return item[(head + i) % QUEUE_SIZE]; }
+    void pop (void) { head = (head + 1) % QUEUE_SIZE; count--; }
+    frame_t &push (void) {
+      if (count == QUEUE_SIZE) fail("line queue overflow");
+      return item[(head + count++) % QUEUE_SIZE];
+    }
+  } target_line[UPDI_LINES], host_line;
+
+  /* Bytes the host can read : visible after the link latency */
+  struct delivery_t {
+    tick_t visible;
+    uint8_t data;
+  };
+  constexpr size_t DELIVERY_SIZE = 65536;
+  delivery_t delivery[DELIVERY_SIZE];
+  size_t delivery_head, delivery_count;
+
+  tick_t host_bit, host_latency;
+  tick_t tcb_next;
+  bool tcb_on, tcb_pending, make_pending, trst_level;
+  tick_t time_limit;
+  bool trace;
+
+  /* Host script coroutine */
+  ucontext_t fw_context, host_context;
+  jmp_buf exit_context;
+  void (*host_script)(void);
+  tick_t host_wake;
+  bool host_running, host_done, host_receiving;
+  int exit_code;
+  constexpr size_t HOST_STACK = 1L << 20;
+  uint8_t *host_stack;
+
+  void step (tick_t until);
+}
+
+/* Bit time in ticks : BAUD is 64 times the bit rate divisor */
+static SIM::tick_t bit_ticks (volatile USART_t *m) {
+  SIM::tick_t baud = m->BAUD ? m->BAUD : 1;
+  return (m->CTRLB & USART_RXMODE_CLK2X_gc) ? baud : baud * 2;
+}
+
+static uint8_t frame_bits (volatile USART_t *m) {
+  return 1 + 8
+    + ((m->CTRLC & USART_PMODE_gm) ? 1 : 0)
+    + ((m->CTRLC & USART_SBMODE_2BIT_gc) ? 2 : 1);
+}
+
+/* Receivers tolerate about 3% of bit rate error */
+static bool rate_match (SIM::tick_t a, SIM::tick_t b) {
+  SIM::tick_t d = a > b ? a - b : b - a;
+  return d * 100 <= b * 3;
+}
+
+static void fifo_push (SIM::link_t &l, uint8_t data, bool bad) {
+  if (!(l.reg->CTRLB & USART_RXEN_bm)) return;
+  if (l.count == 2) {
+    SIM::stats.overruns++;
+    l.fstat[1] |= USART_BUFOVF_bm;
+    return;
+  }
+  l.fifo[l.count] = bad ? (data ^ 0xA5) : data;
+  l.fstat[l.count] = bad ? USART_FERR_bm : 0;
+  l.count++;
+}
+
+static void start_frame (SIM::link_t &l, uint8_t data, SIM::tick_t start) {
+  l.shifting = true;
+  l.bad = false;
+  l.tx_data = data;
+  l.tx_bit = bit_ticks(l.reg);
+  l.tx_start = start;
+  l.tx_end = start + frame_bits(l.reg) * l.tx_bit;
+  if (&l == &SIM::jtag) return;
+  /* The UPDI wire is shared : both sides driving it at once is a collision */
+  SIM::queue_t &q = SIM::target_line[l.line];
+  for (size_t i = 0; i < q.count; i++) {
+    SIM::frame_t &f = q.at(i);
+    if (f.start < l.tx_end && f.end > start) {
+      f.bad = l.bad = true;
+      SIM::stats.updi_collisions++;
+    }
+  }
+}
+
+/* SIM_TRACE=1 in the environment lists every symbol on both links */
+static void trace_symbol (const char *link, uint8_t data, bool bad) {
+  if (!SIM::trace) return;
+  fprintf(stderr, "%12.3f %s %02X%s\n", (double) SIM::now / TICKS_PER_US, link, data, bad ? " !" : "");
+}
+
+static void tx_done (SIM::link_t &l) {
+  if (&l == &SIM::jtag) {
+    if (l.reg->CTRLB & USART_TXEN_bm) {
+      bool bad = !rate_match(l.tx_bit, SIM::host_bit);
+      if (bad) SIM::stats.jtag_errors++;
+      if (SIM::delivery_count == SIM::DELIVERY_SIZE) SIM::fail("host receive overflow");
+      SIM::delivery_t &d = SIM::delivery[(SIM::delivery_head + SIM::delivery_count++) % SIM::DELIVERY_SIZE];
+      d.visible = l.tx_end + SIM::host_latency;
+      d.data = bad ? (l.tx_data ^ 0xA5) : l.tx_data;
+      trace_symbol("JTAG <", l.tx_data, bad);
+      SIM::stats.jtag_out++;
+      if (SIM::host_receiving && d.visible < SIM::host_wake) SIM::host_wake = d.visible;
+    }
+  }
+  else {
+    /* Loopback : the programmer hears its own symbol, the target decodes it */
+    SIM::stats.updi_out++;
+    trace_symbol(l.line ? "GANG >" : "UPDI >", l.tx_data, l.bad);
+    fifo_push(l, l.tx_data, l.bad);
+    TARGET::receive(l.line, l.tx_end, l.tx_data, l.tx_bit, !l.bad);
+  }
+  if (l.full) {
+    l.full = false;
+    start_frame(l, l.buf_data, l.tx_end);
+  }
+  else {
+    l.shifting = false;
+    l.txc = true;
+  }
+}
+
+static void fold_port (PORT_t &p) {
+  p.DIR = ((p.DIR | p.DIRSET) & ~p.DIRCLR) ^ p.DIRTGL;
+  p.OUT = ((p.OUT | p.OUTSET) & ~p.OUTCLR) ^ p.OUTTGL;
+  p.DIRSET = p.DIRCLR = p.DIRTGL = 0;
+  p.OUTSET = p.OUTCLR = p.OUTTGL = 0;
+}
+
+/* Strobe registers fold into their targets, pins and the timer follow */
+static void fold (void) {
+  fold_port(PORTA); fold_port(PORTB); fold_port(PORTC);
+  fold_port(PORTD); fold_port(PORTE); fold_port(PORTF);
+  PORTC.IN |= _BV(0);   /* TDAT idles high */
+  bool trst = (PORTC.DIR & SIM::TRST_BIT) && !(PORTC.OUT & SIM::TRST_BIT);
+  if (trst != SIM::trst_level) {
+    SIM::trst_level = trst;
+    TARGET::reset_pin(trst);
+  }
+  if ((PORTF.PIN6CTRL & PORT_ISC_gm) != PORT_ISC_FALLING_gc) SIM::make_pending = false;
+  PORTF.INTFLAGS = SIM::make_pending ? SIM::MAKE_BIT : 0;
+  if (TCB1.CTRLA & TCB_ENABLE_bm) {
+    if (!SIM::tcb_on || TCB1.CNT == 0) {
+      SIM::tcb_on = true;
+      SIM::tcb_pending = false;
+      SIM::tcb_next = SIM::now + SIM::MILLI_TICKS;
+      TCB1.CNT = 1;
+    }
+  }
+  else {
+    SIM::tcb_on = SIM::tcb_pending = false;
+  }
+}
+
+static void call_vector (void (*vector)(void)) {
+  SIM::SREG_I = 0;
+  vector();
+  SIM::SREG_I = 1;
+}
+
+/* Priority follows the vector table : TCB1, USART0, PORTF */
+static void dispatch (void) {
+  while (SIM::SREG_I) {
+    fold();
+    if (SIM::tcb_pending && (TCB1.INTCTRL & TCB_CAPT_bm)) {
+      SIM::tcb_pending = false;
+      call_vector(TCB1_INT_vect);
+    }
+    else if ((USART0.CTRLA & USART_RXCIE_bm) && SIM::jtag.count) {
+      call_vector(USART0_RXC_vect);
+    }
+    else if (SIM::make_pending) {
+      SIM::make_pending = false;
+      PORTF.INTFLAGS = SIM::MAKE_BIT;
+      call_vector(PORTF_PORT_vect);
+    }
+    else break;
+  }
+}
+
+static SIM::tick_t next_event (void) {
+  SIM::tick_t t = SIM::NEVER;
+  if (SIM::jtag.shifting && SIM::jtag.tx_end < t) t = SIM::jtag.tx_end;
+  for (uint8_t i = 0; i < SIM::UPDI_LINES; i++) {
+    SIM::link_t &l = SIM::updi[i];
+    SIM::queue_t &q = SIM::target_line[i];
+    if (l.shifting && l.tx_end < t) t = l.tx_end;
+    if (q.count && q.front().end < t) t = q.front().end;
+  }
+  if (SIM::host_line.count && SIM::host_line.front().end < t) t = SIM::host_line.front().end;
+  if (SIM::tcb_on && SIM::tcb_next < t) t = SIM::tcb_next;
+  if (!SIM::host_running && SIM::host_wake < t) t = SIM::host_wake;
+  return t;
+}
+
+static void run_host (void) {
+  SIM::host_running = true;
+  SIM::host_wake = SIM::NEVER;
+  swapcontext(&SIM::fw_context, &SIM::host_context);
+  SIM::host_running = false;
+  if (SIM::host_done) longjmp(SIM::exit_context, 1);
+}
+
+static void handle_events (void) {
+  using namespace SIM;
+  if (jtag.shifting && jtag.tx_end <= now) tx_done(jtag);
+  for (uint8_t i = 0; i < UPDI_LINES; i++) {
+    link_t &l = updi[i];
+    queue_t &q = target_line[i];
+    if (l.shifting && l.tx_end <= now) tx_done(l);
+    while (q.count && q.front().end <= now) {
+      frame_t &f = q.front();
+      bool bad = f.bad || !rate_match(f.bit, bit_ticks(l.reg));
+      stats.updi_in++;
+      trace_symbol(i ? "GANG <" : "UPDI <", f.data, bad);
+      fifo_push(l, f.data, bad);
+      q.pop();
+    }
+  }
+  while (host_line.count && host_line.front().end <= now) {
+    frame_t &f = host_line.front();
+    bool bad = !rate_match(f.bit, bit_ticks(jtag.reg));
+    if (bad) stats.jtag_errors++;
+    stats.jtag_in++;
+    trace_symbol("JTAG >", f.data, bad);
+    fifo_push(jtag, f.data, bad);
+    host_line.pop();
+  }
+  while (tcb_on && tcb_next <= now) {
+    tcb_pending = true;
+    tcb_next += MILLI_TICKS;
+  }
+  if (!host_running && host_wake <= now) run_host();
+}
+
+void SIM::step (tick_t until) {
+  fold();
+  dispatch();
+  for (;;) {
+    tick_t t = next_event();
+    if (t > until) break;
+    if (t > now) now = t;
+    if (now > time_limit) fail("time limit exceeded");
+    handle_events();
+    fold();
+    dispatch();
+  }
+  if (until > now) now = until;
+}
+
+void SIM::poll (void) {
+  step(now + POLL_TICKS);
+}
+
+void SIM::idle_until (tick_t until) {
+  step(until);
+}
+
+void SIM::fail (const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  fprintf(stderr, "FAIL [%10.3f ms] ", (double) now / MILLI_TICKS);
+  vfprintf(stderr, format, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+  exit(1);
+}
+
+SIM::tick_t SIM::target_send (uint8_t line, tick_t start, uint8_t data, tick_t bit) {
+  queue_t &q = target_line[line];
+  link_t &l = updi[line];
+  if (start < q.line_free) start = q.line_free;
+  frame_t &f = q.push();
+  f.start = start;
+  f.bit = bit;
+  f.end = start + 12 * bit;
+  f.data = data;
+  f.bad = false;
+  if (l.shifting && l.tx_start < f.end && l.tx_end > start) {
+    f.bad = l.bad = true;
+    stats.updi_collisions++;
+  }
+  q.line_free = f.end;
+  return f.end;
+}
+
+/* A BREAK drops the responses that have not finished yet */
+void SIM::target_abort (uint8_t line) {
+  target_line[line].count = 0;
+  target_line[line].line_free = now;
+}
+
+static void host_entry (void) {
+  SIM::host_script();
+  SIM::host_done = true;
+  swapcontext(&SIM::host_context, &SIM::fw_context);
+}
+
+int SIM::run (void (*script)(void), uint32_t limit_ms) {
+  memset(host_flash, 0xFF, sizeof(host_flash));
+  jtag.reg = &USART0;
+  updi[0].reg = &USART1;
+  updi[1].reg = &USART2;
+  updi[1].line = 1;
+  PORTA.IN = PORTB.IN = PORTC.IN = PORTD.IN = PORTE.IN = PORTF.IN = 0xFF;
+  host_bit = (F_CPU * 8) / 19200;
+  host_latency = 0;
+  host_wake = 0;
+  time_limit = (tick_t) limit_ms * MILLI_TICKS;
+  host_script = script;
+  trace = getenv("SIM_TRACE") != nullptr;
+  host_stack = (uint8_t*) malloc(HOST_STACK);
+  getcontext(&host_context);
+  host_context.uc_stack.ss_sp = host_stack;
+  host_context.uc_stack.ss_size = HOST_STACK;
+  host_context.uc_link = nullptr;
+  makecontext(&host_context, host_entry, 0);
+  if (setjmp(exit_context) == 0) {
+    fw_main();
+  }
+  free(host_stack);
+  return exit_code;
+}
+
+/* Host script */
+
+static void host_wait_until (SIM::tick_t until) {
+  SIM::host_wake = until;
+  swapcontext(&SIM::host_context, &SIM::fw_context);
+}
+
+void HOST::wait_us (uint32_t us) {
+  host_wait_until(SIM::now + (SIM::tick_t) us * TICKS_PER_US);
+}
+
+uint64_t HOST::time_us (void) {
+  return SIM::now / TICKS_PER_US;
+}
+
+void HOST::set_baud (uint32_t baud) {
+  SIM::host_bit = (F_CPU * 8 + baud / 2) / baud;
+}
+
+void HOST::set_latency (uint32_t us) {
+  SIM::host_latency = (SIM::tick_t) us * TICKS_PER_US;
+}
+
+/* One write call is one USB transfer : it leaves after the latency */
+void HOST::send (const uint8_t *data, size_t len) {
+  SIM::tick_t start = SIM::now + SIM::host_latency;
+  if (start < SIM::host_line.line_free) start = SIM::host_line.line_free;
+  while (len--) {
+    SIM::frame_t &f = SIM::host_line.push();
+    f.start = start;
+    f.bit = SIM::host_bit;
+    f.end = start + 10 * f.bit;
+    f.data = *data++;
+    f.bad = false;
+    start = f.end;
+  }
+  SIM::host_line.line_free = start;
+}
+
+int HOST::recv (uint32_t timeout_us) {
+  SIM::tick_t limit = SIM::now + (SIM::tick_t) timeout_us * TICKS_PER_US;
+  for (;;) {
+    if (SIM::delivery_count) {
+      SIM::delivery_t &d = SIM::delivery[SIM::delivery_head];
+      if (d.visible <= SIM::now) {
+        SIM::delivery_head = (SIM::delivery_head + 1) % SIM::DELIVERY_SIZE;
+        SIM::delivery_count--;
+        return d.data;
+      }
+    }
+    if (SIM::now >= limit) return -1;
+    SIM::tick_t wake = limit;
+    if (SIM::delivery_count && SIM::delivery[SIM::delivery_head].visible < wake) {
+      wake = SIM::delivery[SIM::delivery_head].visible;
+    }
+    SIM::host_receiving = true;
+    host_wait_until(wake);
+    SIM::host_receiving = false;
+  }
+}
+
+void HOST::flush (void) {
+  SIM::delivery_count = 0;
+}
+
+/* The MAKE input : DTR/RTS of an open port pulls it low */
+void HOST::set_make (bool low) {
+  bool was_low = !(PORTF.IN & SIM::MAKE_BIT);
+  if (low) PORTF.IN &= ~SIM::MAKE_BIT;
+  else PORTF.IN |= SIM::MAKE_BIT;
+  if (low && !was_low && (PORTF.PIN6CTRL & PORT_ISC_gm) == PORT_ISC_FALLING_gc) {
+    SIM::make_pending = true;
+  }
+}
+
+void HOST::make_pulse (uint32_t us) {
+  HOST::set_make(true);
+  HOST::wait_us(us);
+  HOST::set_make(false);
+}
+
+void HOST::set_strap (bool low) {
+  if (low) PORTD.IN &= ~SIM::STRAP_BIT;
+  else PORTD.IN |= SIM::STRAP_BIT;
+}
+
+/* Firmware services */
+
+void TIMER::setup (void) {}
+
+uint16_t TIMER::millis (void) {
+  SIM::poll();
+  return SIM::now / SIM::MILLI_TICKS;
+}
+
+uint16_t TIMER::micros (void) {
+  SIM::poll();
+  return SIM::now / TICKS_PER_US;
+}
+
+uint32_t TIMER::micros32 (void) {
+  SIM::poll();
+  return SIM::now / TICKS_PER_US;
+}
+
+void TIMER::delay (uint16_t ms) {
+  SIM::idle_until(SIM::now + (SIM::tick_t) ms * SIM::MILLI_TICKS);
+}
+
+void TIMER::delay_us (uint16_t us) {
+  SIM::idle_until(SIM::now + (SIM::tick_t) us * TICKS_PER_US);
+}
+
+static SIM::link_t &link_of (volatile USART_t *m) {
+  if (m == &USART0) return SIM::jtag;
+  if (m == &USART1) return SIM::updi[0];
+  if (m == &USART2) return SIM::updi[1];
+  SIM::fail("USART not simulated");
+}
+
+bool USART::is_rx_ready (volatile USART_t *hwserial_module) {
+  SIM::poll();
+  return link_of(hwserial_module).count != 0;
+}
+
+bool USART::is_tx_ready (volatile USART_t *hwserial_module) {
+  SIM::poll();
+  return !link_of(hwserial_module).full;
+}
+
+bool USART::is_tx_complete (volatile USART_t *hwserial_module) {
+  SIM::poll();
+  return link_of(hwserial_module).txc;
+}
+
+void USART::write (volatile USART_t *hwserial_module, uint8_t data) {
+  SIM::link_t &l = link_of(hwserial_module);
+  l.txc = false;
+  if (!(hwserial_module->CTRLB & USART_TXEN_bm)) return;
+  if (!l.shifting) start_frame(l, data, SIM::now);
+  else {
+    if (l.full) SIM::stats.overruns++;
+    l.full = true;
+    l.buf_data = data;
+  }
+}
+
+uint8_t USART::read_status (volatile USART_t *hwserial_module) {
+  SIM::link_t &l = link_of(hwserial_module);
+  return l.count ? (USART_RXCIF_bm | l.fstat[0]) : 0;
+}
+
+uint8_t USART::read (volatile USART_t *hwserial_module) {
+  SIM::link_t &l = link_of(hwserial_module);
+  if (!l.count) return 0;
+  uint8_t data = l.fifo[0];
+  l.fifo[0] = l.fifo[1];
+  l.fstat[0] = l.fstat[1];
+  l.fstat[1] = 0;
+  l.count--;
+  return data;
+}
+
+/* Self programming writes the simulated host flash */
+void STORE::spm_word (uint32_t addr, uint16_t data) {
+  addr &= sizeof(SIM::host_flash) - 2;
+  if (NVMCTRL.CTRLA == NVMCTRL_CMD_FLPER_gc) {
+    memset(&SIM::host_flash[addr & ~511L], 0xFF, 512);
+  }
+  else if (NVMCTRL.CTRLA == NVMCTRL_CMD_FLWR_gc) {
+    SIM::host_flash[addr] &= data;
+    SIM::host_flash[addr + 1] &= data >> 8;
+  }
+}
+
+uint8_t pgm_read_byte_far (uint32_t addr) {
+  return SIM::host_flash[addr % sizeof(SIM::host_flash)];
+}
+
+uint16_t pgm_read_word_far (uint32_t addr) {
+  return pgm_read_byte_far(addr) | (pgm_read_byte_far(addr + 1) << 8);
+}
+
+uint32_t pgm_read_dword_far (uint32_t addr) {
+  return pgm_read_word_far(addr) | ((uint32_t) pgm_read_word_far(addr + 2) << 16);
+}
+
+// end of code
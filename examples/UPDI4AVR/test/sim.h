@@ -0,0 +1,68 @@
+/**
+ * @file sim.h
+ * @author UPDI4AVR contributors
+ * @brief Host side simulator : virtual clock, USART links and vectors
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/* One tick is 1/8 of the F_CPU clock : the USART baud register unit */
+#define TICKS_PER_US ((F_CPU * 8) / 1000000L)
+
+namespace SIM {
+  typedef uint64_t tick_t;
+
+  /* UPDI lines : USART1 is the primary, USART2 a gang secondary */
+  constexpr uint8_t UPDI_LINES = 2;
+
+  /* Counters reported by the benchmark */
+  struct stats_t {
+    uint32_t updi_out;        /* symbols programmer to target */
+    uint32_t updi_in;         /* symbols target to programmer */
+    uint32_t updi_breaks;
+    uint32_t updi_collisions;
+    uint32_t jtag_out;        /* bytes programmer to host */
+    uint32_t jtag_in;         /* bytes host to programmer */
+    uint32_t jtag_errors;     /* framing errors both ways */
+    uint32_t overruns;        /* receive FIFO overflows */
+  };
+
+  extern tick_t now;
+  extern stats_t stats;
+  extern uint8_t host_flash[0x20000];
+  extern bool trace;          /* SIM_TRACE is set in the environment */
+
+  /* Firmware side */
+  void poll (void);
+  void idle_until (tick_t until);
+
+  /* Runs the firmware with a host script until the script returns */
+  int run (void (*script)(void), uint32_t limit_ms = 600000);
+  [[noreturn]] void fail (const char *format, ...);
+
+  /* Target side of a UPDI line : a response frame starts at the given time */
+  tick_t target_send (uint8_t line, tick_t start, uint8_t data, tick_t bit_ticks);
+  void target_abort (uint8_t line);
+}
+
+/* Script side : runs on its own stack, time stands still while it runs */
+namespace HOST {
+  void wait_us (uint32_t us);
+  uint64_t time_us (void);
+  void set_baud (uint32_t baud);
+  void set_latency (uint32_t us);
+  void send (const uint8_t *data, size_t len);
+  int recv (uint32_t timeout_us);
+  void flush (void);
+  void set_make (bool low);
+  void make_pulse (uint32_t us = 1000);
+  void set_strap (bool low);
+}
+
+// end of code
@@ -0,0 +1,889 @@
+/**
+ * @file target.cpp
+ * @author UPDI4AVR contributors
+ * @brief Simulated UPDI target : SIB, ASI registers and NVMCTRL v0/v2/v3/v4
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "target.h"
+
+namespace TARGET {
+  const config_t configs[] = {
+    /* name     part          SIB                                   signature
+                flash base    size      page  EEPROM page  FUSE    USERROW      SIGROW
+                startup erase  write  EEPROM chip */
+      { "mega0", "m4809",     "megaAVR P:0D:1-3M2 (01.59B14.0)", { 0x1E, 0x96, 0x51 }
+              , 0x4000,     0xC000,   128,  256, 64,  0x1280, 0x1300, 64,  0x1100
+              , 8000,   2000,  2000,  4000,  10000 }
+    , { "tiny2", "t3226",     "tinyAVR P:0D:1-3M2 (01.59B20.0)", { 0x1E, 0x95, 0x27 }
+              , 0x8000,     0x8000,   128,  256, 64,  0x1280, 0x1300, 32,  0x1100
+              , 8000,   2000,  2000,  4000,  10000 }
+    , { "dx",    "avr128db32", "    AVR P:2D:1-3M2 (A3.KV00S.0)", { 0x1E, 0x97, 0x0D }
+              , 0x800000,   0x20000,  512,  512, 1,   0x1050, 0x1080, 32,  0x1100
+              , 1000,   10000, 11,    10000, 50000 }
+    , { "ea",    "avr64ea32", "    AVR P:3D:1-3M2 (A1.KV00K.0)", { 0x1E, 0x96, 0x16 }
+              , 0x800000,   0x10000,  128,  512, 8,   0x1050, 0x1080, 64,  0x1100
+              , 1000,   4000,  2000,  4000,  40000 }
+    , { "du",    "avr64du32", "    AVR P:4D:1-3M2 (A0.KV00S.0)", { 0x1E, 0x96, 0x21 }
+              , 0x800000,   0x10000,  512,  256, 1,   0x1050, 0x1200, 512, 0x1080
+              , 1000,   10000, 11,    10000, 50000 }
+  };
+
+  uint32_t nvm_errors;
+  uint32_t updi_errors;
+
+  enum region_e {
+      R_NONE
+    , R_NVMCTRL
+    , R_FLASH
+    , R_EEPROM
+    , R_FUSE
+    , R_USERROW
+    , R_SIGROW
+    , R_RAM
+  };
+
+  /* UPDI physical and access layer */
+  enum state_e {
+      S_DISABLED
+    , S_IDLE
+    , S_OPCODE
+    , S_COLLECT
+    , S_ERROR
+  };
+  enum phase_e {
+      P_LDS_ADDR
+    , P_STS_ADDR
+    , P_STS_DATA
+    , P_ST_PTR
+    , P_ST_DATA
+    , P_STCS
+    , P_REPEAT
+    , P_KEY
+  };
+  enum pesig_e {
+      PESIG_NONE
+    , PESIG_PARITY
+    , PESIG_FRAME
+    , PESIG_TIMEOUT
+    , PESIG_CLOCK
+    , PESIG_BUS = 6
+  };
+
+  /* ASI */
+  const uint8_t nvmprog_key[8] = { 0x20, 0x67, 0x6F, 0x72, 0x50, 0x4D, 0x56, 0x4E };
+  const uint8_t erase_key[8]   = { 0x65, 0x73, 0x61, 0x72, 0x45, 0x4D, 0x56, 0x4E };
+  const uint8_t urow_key[8]    = { 0x65, 0x74, 0x26, 0x73, 0x55, 0x4D, 0x56, 0x4E };
+
+  /* NVMCTRL */
+  enum flash_op_e { OP_NONE, OP_ERASE, OP_WRITE };
+
+  /* One target on one UPDI line : state and memories of its own */
+  struct unit_t {
+    uint8_t line;
+    const config_t *config;
+
+    /* Memories */
+    uint8_t flash_mem[0x40000];
+    uint8_t eeprom_mem[1024];
+    uint8_t fuse_mem[16];
+    uint8_t userrow_mem[512];
+    uint8_t sigrow_mem[64];
+    uint8_t ram_mem[0x10000];
+
+    /* UPDI physical and access layer */
+    state_e state;
+    phase_e phase;
+    uint8_t opcode, need, got, buf[16];
+    uint32_t address, ptr;
+    uint16_t repeat, remain;
+    SIM::tick_t synced_bit, respond_at;
+    uint32_t cap_baud;
+    uint32_t fault_in;
+    bool silent;
+
+    /* ASI */
+    uint8_t cs_ctrla, cs_ctrlb, key_status, clksel, pesig, sys_ctrla;
+    bool reset_req, reset_line, in_reset, nvmprog, urowprog, locked;
+    SIM::tick_t boot_at, erase_done_at, urow_done_at;
+    uint32_t reset_count;
+
+    /* NVMCTRL */
+    uint8_t nvm_reg[16];
+    uint8_t nvm_cmd, nvm_error;
+    SIM::tick_t fbusy, ebusy;
+    flash_op_e flash_op;
+    uint8_t pagebuf[512];
+    bool pageload[512];
+    region_e pb_region;
+    uint32_t pb_addr;
+    uint8_t eebuf[8];
+    bool eeload[8];
+    region_e ee_region;
+    uint32_t ee_addr;
+    uint8_t ee_ops;
+
+    SIM::tick_t us (uint32_t value) { return (SIM::tick_t) value * TICKS_PER_US; }
+    bool is_v0 (void) { return config->sib[10] == '0'; }
+    bool is_v3 (void) { return config->sib[10] == '3'; }
+    bool in_rstsys (void) { return in_reset || SIM::now < boot_at; }
+
+    bool dropped (void);
+    void nvm_fault (const char *why, uint32_t addr = 0);
+    region_e region_of (uint32_t addr, uint32_t &offset);
+    uint8_t *cell_of (region_e region, uint32_t offset);
+    uint8_t nvm_status (void);
+    bool nvm_busy (void);
+    void start_flash (flash_op_e op, uint32_t time_us);
+    void erase_flash_pages (uint32_t addr, uint8_t order);
+    void clear_pagebuf (void);
+    void clear_eebuf (void);
+    void write_pagebuf (bool erase);
+    void write_eebuf (bool erase, bool write);
+    void chip_erase (void);
+    void nvm_command_v0 (uint8_t cmd);
+    void nvm_command (uint8_t cmd);
+    uint8_t nvm_read (uint32_t offset);
+    void nvm_write (uint32_t offset, uint8_t data);
+    void nvm_data (region_e region, uint32_t offset, uint32_t addr, uint8_t data);
+    uint8_t mem_read (uint32_t addr);
+    void mem_write (uint32_t addr, uint8_t data);
+    void update_keys (void);
+    void update_reset (void);
+    uint8_t sys_status (void);
+    uint8_t cs_read (uint8_t code);
+    void disable (void);
+    void cs_write (uint8_t code, uint8_t data);
+    void error (uint8_t code);
+    void respond (uint8_t data);
+    void ack (void);
+    void collect (phase_e phase, uint8_t need);
+    uint32_t collected (void);
+    uint32_t mask_ptr (uint32_t addr);
+    void instruction (uint8_t op);
+    void complete (void);
+    SIM::tick_t min_bit (void);
+    void receive (SIM::tick_t end, uint8_t data, SIM::tick_t bit, bool valid);
+  };
+
+  unit_t units[SIM::UPDI_LINES];
+  /* setup, fill and the inspection calls act on this one */
+  unit_t *unit = &units[0];
+}
+
+const TARGET::config_t *TARGET::find (const char *name) {
+  for (auto &c : configs) {
+    if (strcmp(c.name, name) == 0 || strcmp(c.part, name) == 0) return &c;
+  }
+  return nullptr;
+}
+
+void TARGET::select (uint8_t line) {
+  if (line >= SIM::UPDI_LINES) SIM::fail("no UPDI line %u", line);
+  unit = &units[line];
+}
+
+uint8_t TARGET::nvm_version (void) {
+  return unit->config->sib[10];
+}
+
+uint8_t *TARGET::flash (void) { return unit->flash_mem; }
+uint8_t *TARGET::eeprom (void) { return unit->eeprom_mem; }
+bool TARGET::in_nvmprog (void) { return unit->nvmprog && !unit->in_rstsys(); }
+uint32_t TARGET::resets (void) { return unit->reset_count; }
+
+/* Old contents : a chip erase that did not happen shows up in the verify */
+void TARGET::fill (uint8_t seed) {
+  uint32_t x = 0x12345678 ^ seed;
+  for (auto &b : unit->flash_mem) { x = x * 1103515245 + 12345; b = x >> 24; }
+  for (auto &b : unit->eeprom_mem) { x = x * 1103515245 + 12345; b = x >> 24; }
+}
+
+void TARGET::setup (const config_t *target, uint32_t max_baud) {
+  unit_t &u = *unit;
+  u.line = unit - units;
+  u.config = target;
+  u.cap_baud = max_baud;
+  fill(0);
+  memset(u.fuse_mem, 0, sizeof(u.fuse_mem));
+  memset(u.userrow_mem, 0xFF, sizeof(u.userrow_mem));
+  memset(u.sigrow_mem, 0, sizeof(u.sigrow_mem));
+  memcpy(u.sigrow_mem, target->signature, 3);
+  for (int i = 0; i < 16; i++) u.sigrow_mem[0x10 + i] = 0xA0 + i;
+  u.state = S_DISABLED;
+  u.clksel = 3;
+  u.synced_bit = (F_CPU * 8) / 225000;
+  u.fault_in = 0;
+  u.silent = false;
+}
+
+void TARGET::fail_after (uint32_t symbols) {
+  unit->fault_in = symbols;
+}
+
+/* Counts a symbol toward an armed fault : true once the target is off the line */
+bool TARGET::unit_t::dropped (void) {
+  if (silent) return true;
+  if (fault_in && --fault_in == 0) {
+    if (SIM::trace) fprintf(stderr, "%12.3f target: off the line\n", (double) SIM::now / TICKS_PER_US);
+    silent = true;
+  }
+  return silent;
+}
+
+/* Faults of the NVM programming sequence : the benchmark must see none */
+void TARGET::unit_t::nvm_fault (const char *why, uint32_t addr) {
+  TARGET::nvm_errors++;
+  nvm_error = 1;
+  fprintf(stderr, "target: NVM %s at %06X [%.3f ms]\n", why, addr,
+    (double) SIM::now / (1000.0 * TICKS_PER_US));
+}
+
+TARGET::region_e TARGET::unit_t::region_of (uint32_t addr, uint32_t &offset) {
+  if (is_v0()) addr &= 0xFFFF;
+  offset = addr - config->flash_base;
+  if (addr >= config->flash_base && offset < config->flash_size) return R_FLASH;
+  offset = addr - 0x1000;
+  if (offset < 16) return R_NVMCTRL;
+  offset = addr - 0x1400;
+  if (offset < config->eeprom_size) return R_EEPROM;
+  offset = addr - config->fuse;
+  if (offset < 16) return R_FUSE;
+  offset = addr - config->userrow;
+  if (offset < config->userrow_size) return R_USERROW;
+  offset = addr - config->sigrow;
+  if (offset < sizeof(sigrow_mem)) return R_SIGROW;
+  offset = addr;
+  if (addr < 0x10000) return R_RAM;
+  return R_NONE;
+}
+
+uint8_t *TARGET::unit_t::cell_of (region_e region, uint32_t offset) {
+  switch (region) {
+    case R_FLASH   : return &flash_mem[offset];
+    case R_EEPROM  : return &eeprom_mem[offset];
+    case R_FUSE    : return &fuse_mem[offset];
+    case R_USERROW : return &userrow_mem[offset];
+    default        : return nullptr;
+  }
+}
+
+/* NVMCTRL : busy flags and the error field */
+
+uint8_t TARGET::unit_t::nvm_status (void) {
+  uint8_t s = 0;
+  if (SIM::now < fbusy) s |= 1;
+  if (SIM::now < ebusy) s |= 2;
+  if (nvm_error) s |= is_v0() ? 4 : (nvm_error << 4);
+  return s;
+}
+
+bool TARGET::unit_t::nvm_busy (void) {
+  return (nvm_status() & 3) != 0;
+}
+
+void TARGET::unit_t::start_flash (flash_op_e op, uint32_t time_us) {
+  SIM::tick_t from = SIM::now > fbusy ? SIM::now : fbusy;
+  fbusy = from + us(time_us);
+  flash_op = op;
+}
+
+void TARGET::unit_t::erase_flash_pages (uint32_t addr, uint8_t order) {
+  uint32_t offset;
+  region_e region = region_of(addr, offset);
+  if (region == R_USERROW) {
+    memset(userrow_mem, 0xFF, config->userrow_size);
+  }
+  else if (region == R_FLASH) {
+    uint32_t span = (uint32_t) config->flash_page << order;
+    offset &= ~(span - 1);
+    if (offset + span > config->flash_size) span = config->flash_size - offset;
+    memset(&flash_mem[offset], 0xFF, span);
+  }
+  else {
+    nvm_fault("page erase outside flash", addr);
+    return;
+  }
+  start_flash(OP_ERASE, config->erase_us);
+}
+
+void TARGET::unit_t::clear_pagebuf (void) {
+  memset(pagebuf, 0xFF, sizeof(pagebuf));
+  memset(pageload, 0, sizeof(pageload));
+}
+
+void TARGET::unit_t::clear_eebuf (void) {
+  memset(eebuf, 0xFF, sizeof(eebuf));
+  memset(eeload, 0, sizeof(eeload));
+}
+
+/* Page buffer to the page of the last loaded address */
+void TARGET::unit_t::write_pagebuf (bool erase) {
+  uint32_t offset;
+  region_e region = region_of(pb_addr, offset);
+  uint16_t page = region == R_FLASH ? config->flash_page
+                : region == R_EEPROM ? config->eeprom_page
+                : config->userrow_size;
+  if (region == R_FLASH || (region == R_USERROW && !is_v0())) {
+    uint8_t *p = cell_of(region, offset & ~(page - 1));
+    for (uint16_t i = 0; i < page; i++) {
+      if (erase) p[i] = 0xFF;
+      p[i] &= pagebuf[i];
+    }
+    start_flash(OP_WRITE, (erase ? config->erase_us : 0) + config->write_us);
+  }
+  else if (region == R_EEPROM || region == R_USERROW) {
+    /* EEPROM like rows change only the loaded bytes */
+    uint8_t *p = cell_of(region, offset & ~(page - 1));
+    for (uint16_t i = 0; i < page; i++) {
+      if (!pageload[i]) continue;
+      if (erase) p[i] = 0xFF;
+      p[i] &= pagebuf[i];
+    }
+    ebusy = SIM::now + us(config->eeprom_us);
+  }
+  else {
+    nvm_fault("page write without a loaded page", pb_addr);
+  }
+  clear_pagebuf();
+}
+
+void TARGET::unit_t::write_eebuf (bool erase, bool write) {
+  uint32_t offset;
+  region_e region = region_of(ee_addr, offset);
+  uint8_t *p = cell_of(region, offset & ~7);
+  if (p == nullptr || region == R_FLASH) {
+    nvm_fault("EEPROM page write without a loaded page", ee_addr);
+    return;
+  }
+  for (uint8_t i = 0; i < 8; i++) {
+    if (!eeload[i]) continue;
+    if (erase) p[i] = 0xFF;
+    if (write) p[i] &= eebuf[i];
+  }
+  ebusy = SIM::now + us(config->eeprom_us);
+  clear_eebuf();
+}
+
+void TARGET::unit_t::chip_erase (void) {
+  memset(flash_mem, 0xFF, config->flash_size);
+  memset(eeprom_mem, 0xFF, config->eeprom_size);
+  fbusy = ebusy = SIM::now + us(config->chip_us);
+  flash_op = OP_ERASE;
+}
+
+void TARGET::unit_t::nvm_command_v0 (uint8_t cmd) {
+  if (cmd != 0 && nvm_busy()) {
+    nvm_fault("command while busy");
+    return;
+  }
+  nvm_error = 0;
+  switch (cmd) {
+    case 0x00 : break;                                      /* NOOP */
+    case 0x01 : write_pagebuf(false); break;                /* WP */
+    case 0x02 : erase_flash_pages(pb_addr, 0); break;       /* ER */
+    case 0x03 : write_pagebuf(true); break;                 /* ERWP */
+    case 0x04 : clear_pagebuf(); break;                     /* PBC */
+    case 0x05 : chip_erase(); break;                        /* CHER */
+    case 0x06 : memset(eeprom_mem, 0xFF, config->eeprom_size);
+                ebusy = SIM::now + us(config->eeprom_us);
+                break;                                      /* EEER */
+    case 0x07 : {                                           /* WFU */
+      uint32_t offset;
+      uint16_t addr = nvm_reg[8] | (nvm_reg[9] << 8);
+      if (region_of(addr, offset) != R_FUSE) {
+        nvm_fault("fuse write outside FUSE", addr);
+        return;
+      }
+      fuse_mem[offset] = nvm_reg[6];
+      ebusy = SIM::now + us(config->eeprom_us);
+      break;
+    }
+    default : nvm_fault("unknown command", cmd);
+  }
+}
+
+/* v2, v3 and v4 hold the command : it must pass NOCMD to change */
+void TARGET::unit_t::nvm_command (uint8_t cmd) {
+  if (cmd == 0x00) {
+    nvm_cmd = cmd;
+    return;
+  }
+  if (nvm_busy()) {
+    nvm_fault("command while busy", cmd);
+    return;
+  }
+  if (nvm_cmd != 0x00 && nvm_cmd != cmd) {
+    nvm_fault("command collision", cmd);
+    nvm_error = 3;
+    return;
+  }
+  nvm_cmd = cmd;
+  nvm_error = 0;
+  if (cmd == 0x20) chip_erase();                            /* CHER */
+  else if (cmd == 0x30) {                                   /* EECHER */
+    memset(eeprom_mem, 0xFF, config->eeprom_size);
+    ebusy = SIM::now + us(config->eeprom_us);
+  }
+  else if (is_v3()) {
+    switch (cmd) {
+      case 0x01 : break;                                    /* NOOP */
+      case 0x04 : write_pagebuf(false); break;              /* FLPW */
+      case 0x05 : write_pagebuf(true); break;               /* FLPERW */
+      case 0x08 : case 0x09 : case 0x0A :
+      case 0x0B : case 0x0C : case 0x0D :                   /* FLPER, FLMPER */
+        erase_flash_pages(pb_addr, cmd - 0x08);
+        break;
+      case 0x0F : clear_pagebuf(); break;                   /* FLPBCLR */
+      case 0x14 : write_eebuf(false, true); break;          /* EEPW */
+      case 0x15 : write_eebuf(true, true); break;           /* EEPERW */
+      case 0x17 : write_eebuf(true, false); break;          /* EEPER */
+      case 0x1F : clear_eebuf(); break;                     /* EEPBCLR */
+      default : nvm_fault("unknown command", cmd);
+    }
+  }
+  else {
+    switch (cmd) {
+      case 0x01 : case 0x02 :                               /* NOOP, FLWR */
+      case 0x08 : case 0x09 : case 0x0A :
+      case 0x0B : case 0x0C : case 0x0D :                   /* FLPER, FLMPER */
+      case 0x12 : case 0x13 :                               /* EEWR, EEERWR */
+        break;
+      default : nvm_fault("unknown command", cmd);
+    }
+  }
+}
+
+uint8_t TARGET::unit_t::nvm_read (uint32_t offset) {
+  uint8_t status_reg = (is_v0() || config->sib[10] == '2') ? 0x02 : 0x06;
+  if (offset == status_reg) return nvm_status();
+  if (offset == 0) return is_v0() ? 0 : nvm_cmd;
+  return nvm_reg[offset];
+}
+
+void TARGET::unit_t::nvm_write (uint32_t offset, uint8_t data) {
+  if (offset == 0) {
+    if (is_v0()) nvm_command_v0(data);
+    else nvm_command(data);
+  }
+  else nvm_reg[offset] = data;
+}
+
+/* A store to a memory under NVMCTRL */
+void TARGET::unit_t::nvm_data (region_e region, uint32_t offset, uint32_t addr, uint8_t data) {
+  uint8_t *cell = cell_of(region, offset);
+  if (is_v0()) {
+    if (nvm_busy()) {
+      nvm_fault("page buffer load while busy", addr);
+      return;
+    }
+    if (region == R_FUSE) {
+      nvm_fault("fuse store outside WFU", addr);
+      return;
+    }
+    uint16_t page = region == R_FLASH ? config->flash_page
+                  : region == R_EEPROM ? config->eeprom_page
+                  : config->userrow_size;
+    pagebuf[offset & (page - 1)] = data;
+    pageload[offset & (page - 1)] = true;
+    pb_region = region;
+    pb_addr = addr;
+    return;
+  }
+  if (is_v3()) {
+    if (region == R_FLASH || region == R_USERROW) {
+      pagebuf[offset & (config->flash_page - 1)] = data;
+      pageload[offset & (config->flash_page - 1)] = true;
+      pb_region = region;
+      pb_addr = addr;
+    }
+    else {
+      eebuf[offset & 7] = data;
+      eeload[offset & 7] = true;
+      ee_region = region;
+      ee_addr = addr;
+    }
+    return;
+  }
+  /* v2 and v4 act on each store with the held command */
+  switch (nvm_cmd) {
+    case 0x02 : {                                           /* FLWR */
+      if (region != R_FLASH && region != R_USERROW) break;
+      if (SIM::now < fbusy && flash_op == OP_ERASE) {
+        nvm_fault("flash write during erase", addr);
+        return;
+      }
+      *cell &= data;
+      /* the bus stalls a word at a time : the busy time adds up */
+      if (offset & 1) start_flash(OP_WRITE, config->write_us);
+      return;
+    }
+    case 0x08 : case 0x09 : case 0x0A :
+    case 0x0B : case 0x0C : case 0x0D :                     /* FLPER, FLMPER */
+      if (region != R_FLASH && region != R_USERROW) break;
+      if (nvm_busy()) {
+        nvm_fault("page erase while busy", addr);
+        return;
+      }
+      erase_flash_pages(addr, nvm_cmd - 0x08);
+      return;
+    case 0x12 : case 0x13 :                                 /* EEWR, EEERWR */
+      if (region == R_FLASH) break;
+      if (SIM::now < ebusy) {
+        if (ee_ops >= 2) {
+          nvm_fault("EEPROM write while busy", addr);
+          return;
+        }
+      }
+      else {
+        ee_ops = 0;
+        ebusy = SIM::now + us(config->eeprom_us);
+      }
+      ee_ops++;
+      if (nvm_cmd == 0x13) *cell = 0xFF;
+      *cell &= data;
+      return;
+  }
+  nvm_fault("store without a matching command", addr);
+}
+
+uint8_t TARGET::unit_t::mem_read (uint32_t addr) {
+  uint32_t offset;
+  if (in_rstsys()) {
+    pesig = PESIG_BUS;
+    return 0;
+  }
+  switch (region_of(addr, offset)) {
+    case R_NVMCTRL : return nvm_read(offset);
+    case R_FLASH   : return flash_mem[offset];
+    case R_EEPROM  : return eeprom_mem[offset];
+    case R_FUSE    : return fuse_mem[offset];
+    case R_USERROW : return userrow_mem[offset];
+    case R_SIGROW  : return sigrow_mem[offset];
+    case R_RAM     : return ram_mem[offset];
+    default        : pesig = PESIG_BUS; return 0;
+  }
+}
+
+void TARGET::unit_t::mem_write (uint32_t addr, uint8_t data) {
+  uint32_t offset;
+  if (in_rstsys()) {
+    pesig = PESIG_BUS;
+    return;
+  }
+  region_e region = region_of(addr, offset);
+  if (region == R_RAM) {
+    ram_mem[offset] = data;
+    return;
+  }
+  if (region == R_NONE || region == R_SIGROW) {
+    pesig = PESIG_BUS;
+    return;
+  }
+  if (urowprog && region == R_USERROW) {
+    userrow_mem[offset] = data;
+    return;
+  }
+  if (!nvmprog) {
+    nvm_fault("store outside NVMPROG", addr);
+    return;
+  }
+  if (region == R_NVMCTRL) nvm_write(offset, data);
+  else nvm_data(region, offset, addr, data);
+}
+
+/* ASI : keys, reset and the system status */
+
+void TARGET::unit_t::update_keys (void) {
+  if ((key_status & 0x08) && !in_reset && SIM::now >= erase_done_at) key_status &= ~0x08;
+  if (urowprog && urow_done_at && SIM::now >= urow_done_at) {
+    urowprog = false;
+    urow_done_at = 0;
+  }
+}
+
+void TARGET::unit_t::update_reset (void) {
+  bool asserted = reset_req || reset_line;
+  if (asserted == in_reset) return;
+  in_reset = asserted;
+  if (asserted) {
+    reset_count++;
+    nvmprog = urowprog = false;
+    nvm_cmd = nvm_error = 0;
+    clear_pagebuf();
+    clear_eebuf();
+    return;
+  }
+  boot_at = SIM::now + us(config->startup_us);
+  if (key_status & 0x08) {
+    /* CHIPERASE : the whole array and the lock go before the system starts */
+    memset(flash_mem, 0xFF, config->flash_size);
+    memset(eeprom_mem, 0xFF, config->eeprom_size);
+    locked = false;
+    boot_at += us(config->chip_us);
+    erase_done_at = boot_at;
+  }
+  if (key_status & 0x10) nvmprog = true;
+  if (key_status & 0x20) urowprog = true;
+}
+
+/* TRST is wired to every target of the fixture */
+void TARGET::reset_pin (bool asserted) {
+  for (auto &u : units) {
+    if (u.config == nullptr) continue;
+    u.reset_line = asserted;
+    u.update_reset();
+  }
+}
+
+uint8_t TARGET::unit_t::sys_status (void) {
+  update_keys();
+  uint8_t s = 0;
+  if (in_rstsys()) s |= 0x20;
+  else if (nvmprog) s |= 0x08;
+  if (urowprog) s |= 0x04;
+  if (locked) s |= 0x01;
+  return s;
+}
+
+uint8_t TARGET::unit_t::cs_read (uint8_t code) {
+  switch (code) {
+    case 0x00 : return 0x30;                                /* STATUSA : UPDIREV 3 */
+    case 0x01 : { uint8_t s = pesig; pesig = 0; return s; } /* STATUSB */
+    case 0x02 : return cs_ctrla;
+    case 0x03 : return cs_ctrlb;
+    case 0x07 : update_keys(); return key_status;
+    case 0x08 : return reset_req ? 0x01 : 0x00;
+    case 0x09 : return clksel;
+    case 0x0A : return sys_ctrla;
+    case 0x0B : return sys_status();
+    default   : return 0;
+  }
+}
+
+void TARGET::unit_t::disable (void) {
+  state = S_DISABLED;
+  key_status = 0;
+  nvmprog = urowprog = false;
+  cs_ctrla = cs_ctrlb = 0;
+  clksel = 3;
+  SIM::target_abort(line);
+}
+
+/* Power off and on : UPDI is disabled again, the memories are kept */
+void TARGET::power_cycle (void) {
+  unit_t &u = *unit;
+  u.disable();
+  u.pesig = 0;
+  u.reset_req = false;
+  u.nvm_cmd = u.nvm_error = 0;
+  u.flash_op = OP_NONE;
+  u.clear_pagebuf();
+  u.clear_eebuf();
+  u.boot_at = SIM::now + u.us(u.config->startup_us);
+}
+
+void TARGET::unit_t::cs_write (uint8_t code, uint8_t data) {
+  switch (code) {
+    case 0x02 : cs_ctrla = data; break;
+    case 0x03 : cs_ctrlb = data; if (data & 0x04) disable(); break;
+    case 0x07 : key_status &= ~data; break;                  /* write one to clear */
+    case 0x08 : reset_req = (data == 0x59); update_reset(); break;
+    case 0x09 : clksel = data & 3; break;
+    case 0x0A :
+      sys_ctrla = data;
+      if ((data & 0x02) && urowprog) urow_done_at = SIM::now + us(config->eeprom_us);
+      break;
+  }
+}
+
+/* UPDI access layer */
+
+void TARGET::unit_t::error (uint8_t code) {
+  if (SIM::trace) fprintf(stderr, "%12.3f target: UPDI error %u\n", (double) SIM::now / TICKS_PER_US, code);
+  pesig = code;
+  state = TARGET::S_ERROR;
+  TARGET::updi_errors++;
+}
+
+void TARGET::unit_t::respond (uint8_t data) {
+  if (dropped()) return;
+  respond_at = SIM::target_send(line, respond_at, data, synced_bit);
+}
+
+void TARGET::unit_t::ack (void) {
+  if (!(cs_ctrla & 0x08)) respond(0x40);            /* unless RSD */
+}
+
+void TARGET::unit_t::collect (phase_e phase, uint8_t need) {
+  this->phase = phase;
+  this->need = need;
+  got = 0;
+  state = TARGET::S_COLLECT;
+}
+
+uint32_t TARGET::unit_t::collected (void) {
+  uint32_t v = 0;
+  for (uint8_t i = got; i--; ) v = (v << 8) | buf[i];
+  return v;
+}
+
+uint32_t TARGET::unit_t::mask_ptr (uint32_t addr) {
+  return is_v0() ? (addr & 0xFFFF) : (addr & 0xFFFFFF);
+}
+
+void TARGET::unit_t::instruction (uint8_t op) {
+  uint8_t size = (op & 3) + 1;
+  uint8_t mode = op & 0x0C;
+  opcode = op;
+  state = S_IDLE;
+  switch (op & 0xE0) {
+    case 0x00 : collect(P_LDS_ADDR, ((op >> 2) & 3) + 1); break;  /* LDS */
+    case 0x40 : collect(P_STS_ADDR, ((op >> 2) & 3) + 1); break;  /* STS */
+    case 0x20 :                                                   /* LD */
+      if (mode == 0x08) {
+        for (uint8_t i = 0; i < size; i++) respond(ptr >> (i * 8));
+      }
+      else {
+        uint32_t n = (uint32_t) repeat + 1;
+        repeat = 0;
+        while (n--) {
+          for (uint8_t i = 0; i < size; i++) respond(mem_read(ptr + i));
+          if (mode == 0x04) ptr = mask_ptr(ptr + size);
+        }
+      }
+      break;
+    case 0x60 :                                                   /* ST */
+      if (mode != 0x08) {
+        remain = repeat + 1;
+        repeat = 0;
+        collect(P_ST_DATA, size);
+      }
+      else collect(P_ST_PTR, size);
+      break;
+    case 0x80 : respond(cs_read(op & 0x0F)); break;               /* LDCS */
+    case 0xC0 : collect(P_STCS, 1); break;                        /* STCS */
+    case 0xA0 : collect(P_REPEAT, size); break;                   /* REPEAT */
+    case 0xE0 :
+      if (op & 0x04) {                                            /* SIB */
+        uint8_t len = 8 << (op & 3);
+        for (uint8_t i = 0; i < len; i++) respond(config->sib[i]);
+      }
+      else collect(P_KEY, 8 << (op & 1));                         /* KEY */
+      break;
+  }
+}
+
+void TARGET::unit_t::complete (void) {
+  uint32_t value = collected();
+  uint8_t size = (opcode & 3) + 1;
+  state = S_IDLE;
+  switch (phase) {
+    case P_LDS_ADDR :
+      for (uint8_t i = 0; i < size; i++) respond(mem_read(value + i));
+      break;
+    case P_STS_ADDR :
+      address = value;
+      ack();
+      collect(P_STS_DATA, size);
+      break;
+    case P_STS_DATA :
+      for (uint8_t i = 0; i < size; i++) mem_write(address + i, buf[i]);
+      ack();
+      break;
+    case P_ST_PTR :
+      ptr = mask_ptr(value);
+      ack();
+      break;
+    case P_ST_DATA :
+      for (uint8_t i = 0; i < size; i++) mem_write(ptr + i, buf[i]);
+      if ((opcode & 0x0C) == 0x04) ptr = mask_ptr(ptr + size);
+      ack();
+      if (--remain) collect(P_ST_DATA, size);
+      break;
+    case P_STCS :
+      cs_write(opcode & 0x0F, buf[0]);
+      break;
+    case P_REPEAT :
+      repeat = value;
+      break;
+    case P_KEY :
+      if (memcmp(buf, nvmprog_key, 8) == 0) key_status |= 0x10;
+      else if (memcmp(buf, erase_key, 8) == 0) key_status |= 0x08;
+      else if (memcmp(buf, urow_key, 8) == 0) key_status |= 0x20;
+      break;
+  }
+}
+
+static bool rate_match (SIM::tick_t a, SIM::tick_t b) {
+  SIM::tick_t d = a > b ? a - b : b - a;
+  return d * 100 <= b * 3;
+}
+
+/* Fastest symbol the selected UPDI clock can recover */
+SIM::tick_t TARGET::unit_t::min_bit (void) {
+  static const uint32_t max_baud[4] = { 900000, 900000, 450000, 225000 };
+  uint32_t baud = max_baud[clksel & 3];
+  if (cap_baud && cap_baud < baud) baud = cap_baud;
+  return (SIM::tick_t)((F_CPU * 8.0) / (baud * 1.02));
+}
+
+void TARGET::receive (uint8_t line, SIM::tick_t end, uint8_t data, SIM::tick_t bit, bool valid) {
+  /* an open line : nothing answers */
+  if (units[line].config != nullptr) units[line].receive(end, data, bit, valid);
+}
+
+void TARGET::unit_t::receive (SIM::tick_t end, uint8_t data, SIM::tick_t bit, bool valid) {
+  if (state == S_DISABLED) {
+    /* the first low level only wakes the interface */
+    state = S_IDLE;
+    return;
+  }
+  if (valid && data == 0 && bit >= synced_bit * 2) {
+    SIM::stats.updi_breaks++;
+    SIM::target_abort(line);
+    repeat = 0;
+    state = S_IDLE;
+    silent = false;
+    return;
+  }
+  if (dropped()) return;
+  if (!valid) {
+    error(PESIG_FRAME);
+    return;
+  }
+  if (state == S_ERROR) return;
+  if (state == S_IDLE) {
+    if (data != 0x55) {
+      error(PESIG_FRAME);
+      return;
+    }
+    if (bit < min_bit()) {
+      error(PESIG_CLOCK);
+      return;
+    }
+    synced_bit = bit;
+    state = S_OPCODE;
+    return;
+  }
+  if (!rate_match(bit, synced_bit)) {
+    error(PESIG_CLOCK);
+    return;
+  }
+  /* responses follow the guard time */
+  respond_at = end + (SIM::tick_t)(128 >> (cs_ctrla & 7)) * synced_bit;
+  if (state == S_OPCODE) {
+    instruction(data);
+    return;
+  }
+  buf[got++] = data;
+  if (got == need) complete();
+}
+
+// end of code
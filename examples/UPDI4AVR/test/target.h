@@ -0,0 +1,65 @@
+/**
+ * @file target.h
+ * @author UPDI4AVR contributors
+ * @brief Simulated UPDI target : SIB, ASI registers and NVMCTRL v0/v2/v3/v4
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include "sim.h"
+
+namespace TARGET {
+  struct config_t {
+    const char *name;
+    const char *part;             /* avrdude part name */
+    char sib[33];
+    uint8_t signature[3];
+    uint32_t flash_base;          /* UPDI address of the flash */
+    uint32_t flash_size;
+    uint16_t flash_page;
+    uint16_t eeprom_size;
+    uint16_t eeprom_page;
+    uint16_t fuse;                /* UPDI addresses of the rows */
+    uint16_t userrow;
+    uint16_t userrow_size;
+    uint16_t sigrow;
+    /* timings in us : flash write is per page on v0/v3, per word on v2/v4 */
+    uint32_t startup_us;
+    uint32_t erase_us;
+    uint32_t write_us;
+    uint32_t eeprom_us;
+    uint32_t chip_us;
+  };
+
+  /* Totals of every target */
+  extern uint32_t nvm_errors;
+  extern uint32_t updi_errors;
+
+  const config_t *find (const char *name);
+  /* One target on each UPDI line : the calls below act on the selected one */
+  /* Line 0 is selected first, a line without setup has nothing connected */
+  void select (uint8_t line);
+  void setup (const config_t *target, uint32_t max_baud = 0);
+  uint8_t nvm_version (void);
+
+  /* Line side : TRST reaches every target */
+  void receive (uint8_t line, SIM::tick_t end, uint8_t data, SIM::tick_t bit_ticks, bool valid);
+  void reset_pin (bool asserted);
+  void power_cycle (void);
+  /* After this many more UPDI symbols either way the target drops off the line */
+  /* until the next BREAK : a loose contact in the middle of a request */
+  void fail_after (uint32_t symbols);
+
+  /* Inspection */
+  uint8_t *flash (void);
+  uint8_t *eeprom (void);
+  bool in_nvmprog (void);
+  uint32_t resets (void);
+  void fill (uint8_t seed);
+}
+
+// end of code
@@ -0,0 +1,63 @@
+/**
+ * @file test_crc.cpp
+ * @author UPDI4AVR contributors
+ * @brief The CRC table of JTAG2 against the avr-libc bitwise update
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <util/crc16.h>
+#include "session.h"
+
+namespace JTAG2 {
+  uint16_t crc16_update (uint16_t crc, uint8_t data);
+  uint16_t crc16_block (uint16_t crc, const uint8_t *data, size_t len);
+}
+
+int main (void) {
+  uint32_t errors = 0;
+
+  /* every CRC state with every data byte */
+  for (uint32_t crc = 0; crc < 0x10000; crc++) {
+    for (uint32_t data = 0; data < 0x100; data++) {
+      uint16_t table = JTAG2::crc16_update(crc, data);
+      uint16_t bitwise = _crc_ccitt_update(crc, data);
+      if (table != bitwise && errors++ < 8) {
+        printf("FAIL crc16_update(%04X, %02X) = %04X, bitwise %04X\n", crc, data, table, bitwise);
+      }
+    }
+  }
+
+  /* blocks of every length up to a large frame, as the session computes them */
+  static uint8_t block[4096 + 10];
+  uint32_t x = 1;
+  for (size_t i = 0; i < sizeof(block); i++) block[i] = (x = x * 1103515245 + 12345) >> 24;
+  for (size_t len = 0; len <= sizeof(block); len += (len < 64 ? 1 : 61)) {
+    uint16_t fw = JTAG2::crc16_block(~0, block, len);
+    uint16_t host = SESSION::crc16(block, len);
+    if (fw != host && errors++ < 8) {
+      printf("FAIL crc16_block length %zu = %04X, session %04X\n", len, fw, host);
+    }
+  }
+
+  /* a frame followed by its own CRC leaves zero */
+  static uint8_t frame[sizeof(block) + 10];
+  size_t size = SESSION::frame(frame, 0x1234, block, 512);
+  if (JTAG2::crc16_block(~0, frame, size) != 0) {
+    printf("FAIL CRC over a whole frame is not zero\n");
+    errors++;
+  }
+
+  if (errors) {
+    printf("FAIL %u CRC mismatches\n", errors);
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
+
+// end of code
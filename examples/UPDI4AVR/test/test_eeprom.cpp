@@ -0,0 +1,72 @@
+/**
+ * @file test_eeprom.cpp
+ * @author UPDI4AVR contributors
+ * @brief EEPROM writes of 1 to 256 bytes across page boundaries, read back
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace EEPROM {
+  using SESSION::config;
+  using SESSION::expect;
+  constexpr uint32_t EEPROM_BASE = 0x1400;
+  uint8_t shadow[1024];   /* what the EEPROM must hold */
+  uint32_t writes;
+
+  void write_at (uint16_t offset, uint16_t len, uint8_t seed) {
+    static uint8_t data[256], back[256];
+    char what[64];
+    for (uint16_t i = 0; i < len; i++) data[i] = seed + i * 13;
+    snprintf(what, sizeof(what), "%u bytes at %03X", len, offset);
+    expect(SESSION::write_page(SESSION::MTYPE_EEPROM_PAGE, EEPROM_BASE + offset, data, len), what);
+    memcpy(&shadow[offset], data, len);
+    expect(SESSION::read_block(SESSION::MTYPE_EEPROM_PAGE, EEPROM_BASE + offset, back, len)
+      && memcmp(back, data, len) == 0, "read back");
+    writes++;
+  }
+
+  void script (void) {
+    const uint16_t lengths[] = { 1, 2, 7, 8, 9, 256 };
+    uint16_t size = config->eeprom_size;
+    uint16_t boundary = 64;   /* a page boundary of every target */
+    uint8_t seed = 1;
+    SESSION::start();
+    for (uint16_t len : lengths) {
+      /* across the boundary, and from an odd start : the v3 8 byte buffer, the v2 pairs */
+      uint16_t starts[] = { (uint16_t)(boundary - len / 2), (uint16_t)(boundary + 3 - len / 2) };
+      for (uint16_t start : starts) {
+        if (start + len > size) start = size - len;
+        write_at(start, len, seed++);
+      }
+      boundary = boundary + 64 < size ? boundary + 64 : 64;
+    }
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+}
+
+int main (int argc, char *argv[]) {
+  using namespace EEPROM;
+  config = TARGET::find(argc > 1 ? argv[1] : "dx");
+  if (config == nullptr) return 2;
+  TARGET::setup(config);
+  TARGET::fill(0xEE);
+  memcpy(shadow, TARGET::eeprom(), config->eeprom_size);
+  SIM::run(script);
+
+  /* neighbours of every write are unchanged */
+  expect(memcmp(TARGET::eeprom(), shadow, config->eeprom_size) == 0, "EEPROM differs outside the written bytes");
+  printf("target   %s, EEPROM page %u : %u writes\n", config->name, config->eeprom_page, writes);
+  return SESSION::finish();
+}
+
+// end of code
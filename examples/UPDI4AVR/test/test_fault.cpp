@@ -0,0 +1,109 @@
+/**
+ * @file test_fault.cpp
+ * @author UPDI4AVR contributors
+ * @brief A target dropping off the line in the middle of a request
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace FAULT {
+  using SESSION::config;
+  using SESSION::expect;
+  using SESSION::image;
+
+  /* Answered once the request before it, posted or not, has finished */
+  bool sync (void) {
+    const uint8_t body[] = { SESSION::CMND_GET_SYNC };
+    return SESSION::command_code(body, sizeof(body)) == SESSION::RSP_OK;
+  }
+
+  uint8_t write_code (uint32_t offset) {
+    static uint8_t body[8192];
+    uint32_t len = config->flash_page;
+    uint32_t addr = config->flash_base + offset;
+    body[0] = SESSION::CMND_WRITE_MEMORY;
+    body[1] = SESSION::MTYPE_XMEGA_FLASH;
+    memcpy(&body[2], &len, 4);
+    memcpy(&body[6], &addr, 4);
+    memcpy(&body[10], &image[offset], len);
+    return SESSION::command_code(body, len + 10);
+  }
+
+  /* A posted write answered RSP_OK fails afterwards */
+  void posted_write (void) {
+    static uint8_t data[512];
+    uint16_t page = config->flash_page;
+    expect(write_code(0) == SESSION::RSP_OK && sync(), "WRITE_MEMORY page 0");
+    TARGET::fail_after(40);
+    expect(write_code(page) == SESSION::RSP_OK, "failing WRITE_MEMORY is not posted");
+
+    /* other requests run as usual */
+    expect(SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, config->flash_base, data, page)
+      && memcmp(data, image, page) == 0, "READ_MEMORY after a failed posted write");
+
+    /* the next write is refused in its place, with the failed address */
+    uint32_t addr = 0;
+    expect(write_code(page * 2) == SESSION::RSP_ILLEGAL_MCU_STATE && SESSION::answer_size == 7,
+      "write after a failed posted write is not refused");
+    memcpy(&addr, &SESSION::answer[3], 4);
+    expect(addr == config->flash_base + page, "refusal does not carry the failed address");
+
+    /* once reported, writes go through again */
+    expect(write_code(page) == SESSION::RSP_OK, "rewrite of the failed page");
+    expect(write_code(page * 2) == SESSION::RSP_OK, "write of the refused page");
+  }
+
+  /* The target drops off after the streamed answer header has gone out */
+  void streamed_read (uint32_t len, uint32_t after, const char *what) {
+    static uint8_t data[8192];
+    uint32_t addr = config->flash_base;
+    char line[80];
+    /* a read elsewhere first : the block must not come from the read-ahead buffer */
+    expect(SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, addr + len * 2, data, len) && sync(), what);
+    TARGET::fail_after(after);
+    uint64_t start = HOST::time_us();
+    bool done = SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, addr, data, len);
+    uint64_t span = HOST::time_us() - start;
+    snprintf(line, sizeof(line), "%s : cut short read is accepted", what);
+    expect(!done, line);
+    /* a frame left short would keep the host waiting for its whole timeout */
+    snprintf(line, sizeof(line), "%s : cut short frame is not ended (%llu us)", what, (unsigned long long) span);
+    expect(span < 3000000, line);
+    snprintf(line, sizeof(line), "%s : read after the failure", what);
+    expect(SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, addr, data, len)
+      && memcmp(data, TARGET::flash(), len) == 0, line);
+  }
+
+  void script (void) {
+    SESSION::start();
+    expect(SESSION::erase(), "XMEGA_ERASE");
+    posted_write();
+    streamed_read(512, 200, "512 byte stream");
+    streamed_read(128, 60, "128 byte stream");
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+}
+
+int main (void) {
+  using namespace FAULT;
+  config = TARGET::find("dx");
+  /* held at the base rate : a failure there is final, not retried slower */
+  /* and the host link at 460800 bps is fast enough to stream reads */
+  TARGET::setup(config, 225000);
+  SESSION::make_image(config->flash_page * 4, 0xFA017);
+  SIM::run(script);
+  expect(memcmp(TARGET::flash(), image, config->flash_page * 3) == 0, "target flash differs from the image");
+  return SESSION::finish();
+}
+
+// end of code
@@ -0,0 +1,115 @@
+/**
+ * @file test_frame.cpp
+ * @author UPDI4AVR contributors
+ * @brief PARAM_MAX_FRAME negotiation, large reads and oversize frames
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace FRAME {
+  using SESSION::config;
+  using SESSION::expect;
+  uint16_t max_read;
+
+  uint8_t set_frame (uint16_t size) {
+    uint8_t body[] = { SESSION::CMND_SET_PARAMETER, SESSION::PARAM_MAX_FRAME, (uint8_t) size, (uint8_t)(size >> 8) };
+    return SESSION::command_code(body, sizeof(body));
+  }
+
+  /* GET answers [granted, largest] */
+  bool get_frame (uint16_t &granted, uint16_t &largest) {
+    if (!SESSION::get_param(SESSION::PARAM_MAX_FRAME) || SESSION::answer_size != 5) return false;
+    granted = SESSION::answer[1] | (SESSION::answer[2] << 8);
+    largest = SESSION::answer[3] | (SESSION::answer[4] << 8);
+    return true;
+  }
+
+  bool granted_is (uint16_t size) {
+    uint16_t granted, largest;
+    return get_frame(granted, largest) && granted == size && largest == max_read;
+  }
+
+  /* A read the firmware refuses is answered, not dropped */
+  uint8_t read_code (uint32_t addr, uint32_t len) {
+    uint8_t body[10] = { SESSION::CMND_READ_MEMORY, SESSION::MTYPE_FLASH_PAGE };
+    memcpy(&body[2], &len, 4);
+    memcpy(&body[6], &addr, 4);
+    return SESSION::command_code(body, sizeof(body));
+  }
+
+  bool read_matches (uint32_t offset, uint32_t len) {
+    static uint8_t data[8192];
+    return SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, config->flash_base + offset, data, len)
+      && memcmp(data, TARGET::flash() + offset, len) == 0;
+  }
+
+  void script (void) {
+    uint16_t granted;
+    SESSION::start();
+
+    /* a new session starts at 512 */
+    expect(get_frame(granted, max_read) && granted == 512, "GET MAX_FRAME is not 512 after sign on");
+    expect(max_read >= 512 && (max_read & (max_read - 1)) == 0, "largest frame is not a power of two");
+    expect(read_matches(0, 512), "512 byte read");
+    expect(read_code(config->flash_base, 1024) == SESSION::RSP_ILLEGAL_MEMORY_RANGE,
+      "1024 byte read before MAX_FRAME is not refused");
+
+    /* odd or short requests are refused and change nothing */
+    expect(set_frame(511) == SESSION::RSP_ILLEGAL_VALUE, "MAX_FRAME 511 is accepted");
+    expect(set_frame(1025) == SESSION::RSP_ILLEGAL_VALUE, "MAX_FRAME 1025 is accepted");
+    expect(set_frame(256) == SESSION::RSP_ILLEGAL_VALUE, "MAX_FRAME 256 is accepted");
+    expect(granted_is(512), "refused MAX_FRAME changed the grant");
+
+    /* even requests are granted up to the largest frame */
+    expect(set_frame(1024) == SESSION::RSP_OK, "MAX_FRAME 1024 is refused");
+    expect(granted_is(1024), "GET MAX_FRAME is not 1024");
+    expect(read_matches(0, 1024), "1024 byte read");
+    expect(read_matches(1024, 258), "258 byte read");
+    expect(read_code(config->flash_base, 1023) == SESSION::RSP_ILLEGAL_MEMORY_RANGE,
+      "odd 1023 byte read is not refused");
+    expect(read_code(config->flash_base, 1026) == SESSION::RSP_ILLEGAL_MEMORY_RANGE,
+      "1026 byte read over the grant is not refused");
+    expect(set_frame(0xFFFE) == SESSION::RSP_OK, "MAX_FRAME 65534 is refused");
+    expect(granted_is(max_read), "MAX_FRAME 65534 is not capped at the largest frame");
+    expect(read_matches(0, max_read), "largest frame read");
+
+    /* a frame longer than the packet buffer is dropped without an answer */
+    static uint8_t body[8192];
+    memset(body, 0xFF, sizeof(body));
+    body[0] = SESSION::CMND_WRITE_MEMORY;
+    SESSION::send_frame(body, max_read + 64);
+    expect(!SESSION::receive_frame(500), "oversize frame is answered");
+    const uint8_t sync[] = { SESSION::CMND_GET_SYNC };
+    expect(SESSION::command_code(sync, sizeof(sync)) == SESSION::RSP_OK, "no answer after an oversize frame");
+    expect(granted_is(max_read), "oversize frame changed the grant");
+
+    /* sign on returns to 512 */
+    expect(SESSION::leave(), "SIGN_OFF");
+    HOST::set_baud(19200);
+    expect(SESSION::sign_on(), "GET_SIGN_ON again");
+    expect(granted_is(512), "GET MAX_FRAME is not 512 after a new sign on");
+    const uint8_t off[] = { SESSION::CMND_SIGN_OFF };
+    expect(SESSION::command_code(off, sizeof(off)) == SESSION::RSP_OK, "SIGN_OFF again");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+}
+
+int main (void) {
+  using namespace FRAME;
+  config = TARGET::find("dx");
+  TARGET::setup(config);
+  TARGET::fill(0x5A);
+  SIM::run(script);
+  return SESSION::finish();
+}
+
+// end of code
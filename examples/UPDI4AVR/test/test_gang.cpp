@@ -0,0 +1,119 @@
+/**
+ * @file test_gang.cpp
+ * @author UPDI4AVR contributors
+ * @brief UPDI_GANG_MODULES : two targets in lock-step, then one diverges
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace GANG {
+  using SESSION::config;
+  using SESSION::expect;
+  using SESSION::image;
+  using SESSION::image_size;
+
+  /* GET PARAM_GANG : bit n is secondary n still in step */
+  bool gang_is (uint8_t mask) {
+    return SESSION::get_param(SESSION::PARAM_GANG) && SESSION::answer_size == 2
+      && SESSION::answer[1] == mask;
+  }
+
+  uint8_t *flash_of (uint8_t line) {
+    TARGET::select(line);
+    uint8_t *p = TARGET::flash();
+    TARGET::select(0);
+    return p;
+  }
+
+  bool write_image (void) {
+    for (uint32_t addr = 0; addr < image_size; addr += config->flash_page) {
+      if (!SESSION::write_page(SESSION::MTYPE_XMEGA_FLASH,
+        config->flash_base + addr, &image[addr], config->flash_page)) return false;
+    }
+    return true;
+  }
+
+  /* One read per page : the frame limit of a new session is 512 */
+  bool verify (uint32_t offset, uint32_t len) {
+    static uint8_t data[512];
+    for (uint32_t end = offset + len; offset < end; offset += config->flash_page) {
+      if (!SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, config->flash_base + offset, data, config->flash_page)
+        || memcmp(data, &image[offset], config->flash_page) != 0) return false;
+    }
+    return true;
+  }
+
+  void end_session (void) {
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(100000);
+  }
+
+  void script (void) {
+    uint16_t page = config->flash_page;
+
+    /* both targets are written and verified as one */
+    SESSION::start();
+    expect(gang_is(0x01), "secondary not in the gang after ENTER_PROGMODE");
+    expect(SESSION::erase(), "XMEGA_ERASE");
+    expect(write_image(), "WRITE_MEMORY");
+    expect(verify(0, image_size), "verify");
+    expect(gang_is(0x01), "secondary dropped from a clean session");
+    end_session();
+    expect(memcmp(flash_of(0), image, image_size) == 0, "primary flash differs from the image");
+    expect(memcmp(flash_of(1), image, image_size) == 0, "secondary flash differs from the image");
+
+    /* a bad cell on the secondary : the read that reaches it drops it, */
+    /* a read ahead included, and the primary goes on */
+    flash_of(1)[page * 3 + 5] ^= 0x10;
+    SESSION::start();
+    expect(gang_is(0x01), "secondary not back in the gang after ENTER_PROGMODE");
+    expect(verify(0, page * 2), "verify before the bad cell");
+    expect(gang_is(0x01), "secondary dropped before the bad cell");
+    expect(verify(page * 2, page * 2), "primary answer changed by a diverging secondary");
+    expect(gang_is(0x00), "diverging secondary still in the gang");
+    expect(verify(0, image_size), "verify after the drop");
+    end_session();
+
+    /* the secondary drops off the line in the middle of a write */
+    SESSION::start();
+    expect(SESSION::erase(), "XMEGA_ERASE");
+    TARGET::select(1);
+    TARGET::fail_after(1000);
+    TARGET::select(0);
+    expect(write_image(), "WRITE_MEMORY with a lost secondary");
+    expect(gang_is(0x00), "lost secondary still in the gang");
+    expect(verify(0, image_size), "verify with a lost secondary");
+    end_session();
+    expect(memcmp(flash_of(0), image, image_size) == 0, "primary flash differs after the secondary was lost");
+    expect(memcmp(flash_of(1), image, image_size) != 0, "lost secondary was written to the end");
+  }
+}
+
+int main (void) {
+  using namespace GANG;
+  config = TARGET::find("dx");
+  TARGET::select(1);
+  TARGET::setup(config);
+  TARGET::fill(0x33);
+  TARGET::select(0);
+  TARGET::setup(config);
+  TARGET::fill(0x11);
+  SESSION::make_image(config->flash_page * 8, 0x6A9C);
+  SIM::run(script);
+  /* the variant sets UPDI_TDAT_PIN_PULLUP : PF0 is the TXD pin of USART2 */
+  expect(PORTF.PIN0CTRL == PORTC.PIN0CTRL && (PORTF.PIN0CTRL & PORT_PULLUPEN_bm),
+    "secondary TDAT pin is not set up as the primary");
+  return SESSION::finish();
+}
+
+// end of code
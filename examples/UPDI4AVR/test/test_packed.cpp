@@ -0,0 +1,96 @@
+/**
+ * @file test_packed.cpp
+ * @author UPDI4AVR contributors
+ * @brief MTYPE_PACKED writes : the session PackBits encoder against JTAG2::unpack
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace PACKED {
+  using SESSION::config;
+  using SESSION::expect;
+  using SESSION::image;
+  using SESSION::image_size;
+  size_t plain_bytes, packed_bytes;
+
+  /* Every page a different shape : runs at the 2, 3, 128 and 129 edges, literals, blanks */
+  uint8_t shape (uint32_t i, uint8_t r) {
+    uint16_t page = config->flash_page;
+    uint32_t n = i / page, o = i % page;
+    switch (n % 8) {
+      case 0 : return r;                                      /* literals only */
+      case 1 : return 0xFF;                                   /* blank, skipped */
+      case 2 : return o < 128 ? 0x11 : o < 257 ? 0x22 : r;
+      case 3 : return (o / 2) & 1 ? 0xAA : 0x55;              /* runs of two */
+      case 4 : return (o / 3) & 1 ? 0x00 : 0x3C;              /* runs of three */
+      case 5 : return o % 16 < 12 ? 0xFF : r;
+      case 6 : return o == page - 1u ? 0x80 : 0x00;
+      default: return o & 0xFF;
+    }
+  }
+
+  /* A malformed stream is refused and nothing is written */
+  void write_raw (uint32_t count, const uint8_t *data, size_t len, const char *what) {
+    static uint8_t body[64];
+    uint32_t addr = config->flash_base + image_size;
+    body[0] = SESSION::CMND_WRITE_MEMORY;
+    body[1] = SESSION::MTYPE_PACKED;
+    memcpy(&body[2], &count, 4);
+    memcpy(&body[6], &addr, 4);
+    body[10] = SESSION::MTYPE_XMEGA_FLASH;
+    memcpy(&body[11], data, len);
+    expect(SESSION::command_code(body, len + 11) == SESSION::RSP_ILLEGAL_VALUE, what);
+  }
+
+  void script (void) {
+    static uint8_t scratch[8192];
+    SESSION::start();
+    expect(SESSION::erase(), "XMEGA_ERASE");
+
+    const uint8_t short_run[] = { 0x81, 0x12 };               /* 128 bytes of 16 */
+    const uint8_t cut_literal[] = { 0x05, 0x01, 0x02 };       /* 6 announced, 2 sent */
+    const uint8_t too_few[] = { 0x83, 0x34 };                 /* 126 of 128 */
+    write_raw(16, short_run, sizeof(short_run), "run past the expanded size is accepted");
+    write_raw(8, cut_literal, sizeof(cut_literal), "truncated literal is accepted");
+    write_raw(128, too_few, sizeof(too_few), "short expansion is accepted");
+    write_raw(0x10000, short_run, sizeof(short_run), "expanded size over the packet is accepted");
+
+    for (uint32_t addr = 0; addr < image_size; addr += config->flash_page) {
+      expect(SESSION::write_packed(SESSION::MTYPE_XMEGA_FLASH,
+        config->flash_base + addr, &image[addr], config->flash_page), "packed WRITE_MEMORY");
+      plain_bytes += config->flash_page + 10;
+      packed_bytes += SESSION::pack(scratch, &image[addr], config->flash_page) + 11;
+    }
+
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+}
+
+int main (int argc, char *argv[]) {
+  using namespace PACKED;
+  config = TARGET::find(argc > 1 ? argv[1] : "dx");
+  if (config == nullptr) return 2;
+  TARGET::setup(config);
+  SESSION::make_image(config->flash_page * 16, 0xBADC0DE, shape);
+  SIM::run(script);
+
+  expect(memcmp(TARGET::flash(), image, image_size) == 0, "target flash differs from the image");
+  bool blank = true;
+  for (uint32_t i = 0; i < config->flash_page; i++) blank &= TARGET::flash()[image_size + i] == 0xFF;
+  expect(blank, "a refused packed write reached the flash");
+  printf("target   %s, %u pages : %zu frame body bytes plain, %zu packed\n",
+    config->name, image_size / config->flash_page, plain_bytes, packed_bytes);
+  return SESSION::finish();
+}
+
+// end of code
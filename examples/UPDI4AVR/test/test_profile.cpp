@@ -0,0 +1,78 @@
+/**
+ * @file test_profile.cpp
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_PROFILE : slot selection, and spans over 65ms recorded in full
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace PROFILE {
+  using SESSION::config;
+  using SESSION::expect;
+
+  /* PROF::prof_slot_e */
+  enum {
+      SLOT_UPDI_CMD   = 0x05
+    , SLOT_JTAG_CMND  = 0x10
+    , SLOT_JTAG_OTHER = 0x26
+  };
+
+  /* The PARAM_PROFILE answer : PROF::prof_record_t */
+  struct record_t {
+    uint32_t min, max, total;
+    uint16_t count;
+  };
+
+  bool get_record (uint8_t slot, record_t &r) {
+    uint8_t body[] = { SESSION::CMND_GET_PARAMETER, SESSION::PARAM_PROFILE, slot };
+    if (!SESSION::command(body, sizeof(body)) || SESSION::answer_size != 15) return false;
+    memcpy(&r.min, &SESSION::answer[1], 4);
+    memcpy(&r.max, &SESSION::answer[5], 4);
+    memcpy(&r.total, &SESSION::answer[9], 4);
+    memcpy(&r.count, &SESSION::answer[13], 2);
+    return true;
+  }
+
+  /* The host saw the answer in at least the span the firmware recorded */
+  void check (const char *name, uint8_t slot, uint8_t cmnd, uint32_t over_us) {
+    record_t r;
+    expect(get_record(slot, r), "GET_PARAMETER PARAM_PROFILE");
+    printf("%-16s %5u %10u %10u\n", name, r.count, r.min, r.max);
+    expect(r.count == 1 && r.min == r.max && r.total == r.max, name);
+    expect(r.max > over_us, "span wrapped around");
+    expect(r.max <= SESSION::latency[cmnd].max_us, "span longer than the host round trip");
+  }
+
+  void script (void) {
+    SESSION::start();
+    expect(SESSION::erase(), "XMEGA_ERASE");
+    printf("%-16s %5s %10s %10s\n", "slot", "count", "min us", "max us");
+    /* sign on holds the target reset and enters UPDI : about 240ms */
+    check("GET_SIGN_ON", SLOT_JTAG_CMND + SESSION::CMND_GET_SIGN_ON, SESSION::CMND_GET_SIGN_ON, 65535);
+    check("UPDI ENTER", SLOT_UPDI_CMD + 1, SESSION::CMND_GET_SIGN_ON, 10000);
+    check("XMEGA_ERASE", SLOT_JTAG_OTHER, SESSION::CMND_XMEGA_ERASE, 10000);
+    uint8_t past[] = { SESSION::CMND_GET_PARAMETER, SESSION::PARAM_PROFILE, SLOT_JTAG_OTHER + 1 };
+    expect(SESSION::command_code(past, sizeof(past)) == SESSION::RSP_ILLEGAL_VALUE, "slot past the last is answered");
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(10000);
+  }
+}
+
+int main (void) {
+  using namespace PROFILE;
+  config = TARGET::find("dx");
+  TARGET::setup(config);
+  SIM::run(script);
+  return SESSION::finish();
+}
+
+// end of code
@@ -0,0 +1,95 @@
+/**
+ * @file test_speed.cpp
+ * @author UPDI4AVR contributors
+ * @brief UPDI link speed : probe once per target, retry a failed command at the base rate
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace SPEED {
+  using SESSION::config;
+  using SESSION::expect;
+
+  struct session_t {
+    uint32_t baud;            /* PARAM_UPDI_BAUD after ENTER_PROGMODE */
+    uint32_t errors;          /* UPDI errors the target saw */
+    uint32_t breaks;
+  };
+
+  uint32_t updi_baud (void) {
+    uint32_t baud = 0;
+    if (SESSION::get_param(SESSION::PARAM_UPDI_BAUD) && SESSION::answer_size == 5) {
+      memcpy(&baud, &SESSION::answer[1], 4);
+    }
+    return baud;
+  }
+
+  bool read_matches (uint32_t offset) {
+    static uint8_t data[512];
+    return SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, config->flash_base + offset, data, config->flash_page)
+      && memcmp(data, TARGET::flash() + offset, config->flash_page) == 0;
+  }
+
+  /* One session : enter, optionally cut the target off in a read, leave */
+  session_t session (const char *name, bool fault) {
+    session_t r;
+    char line[80];
+    uint32_t errors = TARGET::updi_errors, breaks = SIM::stats.updi_breaks;
+    SESSION::start();
+    r.baud = updi_baud();
+    r.errors = TARGET::updi_errors - errors;
+    r.breaks = SIM::stats.updi_breaks - breaks;
+    snprintf(line, sizeof(line), "%s : read", name);
+    expect(read_matches(config->flash_page * 2), line);
+    if (fault) {
+      /* at high speed the host link is slower : the read is not streamed */
+      TARGET::fail_after(100);
+      snprintf(line, sizeof(line), "%s : read failing at high speed is not retried", name);
+      expect(read_matches(0), line);
+      snprintf(line, sizeof(line), "%s : no fallback to the base rate", name);
+      expect(updi_baud() == 225000, line);
+    }
+    snprintf(line, sizeof(line), "%s : SIGN_OFF", name);
+    expect(SESSION::leave(), line);
+    SESSION::close();
+    HOST::wait_us(100000);
+    printf("%-22s %8u bps %3u UPDI errors %3u breaks\n", name, r.baud, r.errors, r.breaks);
+    return r;
+  }
+
+  void script (void) {
+    /* a target held at 225 kbps : only its first session probes */
+    session_t slow1 = session("slow target", false);
+    session_t slow2 = session("slow target again", false);
+    expect(slow1.baud == 225000 && slow2.baud == 225000, "slow target is not at the base rate");
+    expect(slow1.errors > 0, "slow target was not probed");
+    expect(slow2.errors == 0 && slow2.breaks < slow1.breaks, "slow target was probed again");
+
+    /* a target of another signature : probed on its own */
+    TARGET::setup(config = TARGET::find("ea"));
+    TARGET::power_cycle();
+    session_t fast = session("fast target", true);
+    expect(fast.baud == 900000 && fast.errors == 0, "fast target is not at 900 kbps");
+    /* it failed once at 900 kbps : its next session starts one step lower */
+    session_t next = session("fast target again", false);
+    expect(next.baud == 450000, "after a failure the next probe does not start lower");
+  }
+}
+
+int main (void) {
+  using namespace SPEED;
+  config = TARGET::find("dx");
+  TARGET::setup(config, 225000);
+  SIM::run(script);
+  return SESSION::finish();
+}
+
+// end of code
@@ -0,0 +1,98 @@
+/**
+ * @file test_store.cpp
+ * @author UPDI4AVR contributors
+ * @brief PARAM_STORE : record a session, then replay it by the MAKE signal
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace STORE_TEST {
+  using SESSION::config;
+  using SESSION::expect;
+  using SESSION::image;
+  using SESSION::image_size;
+  uint8_t *other;
+
+  bool store_is (uint8_t state, uint16_t count) {
+    return SESSION::get_param(SESSION::PARAM_STORE) && SESSION::answer_size == 4
+      && SESSION::answer[1] == state
+      && (SESSION::answer[2] | (SESSION::answer[3] << 8)) == count;
+  }
+
+  bool flash_is (const uint8_t *data) {
+    return memcmp(TARGET::flash(), data, image_size) == 0;
+  }
+
+  /* A new target on the fixture : its flash holds something else */
+  void swap_target (uint8_t seed) {
+    TARGET::fill(seed);
+    memcpy(other, TARGET::flash(), image_size);
+  }
+
+  void script (void) {
+    uint16_t pages = image_size / config->flash_page;
+    uint8_t state;
+
+    /* record : the host session is kept page by page */
+    SESSION::start();
+    expect(SESSION::erase(), "XMEGA_ERASE");
+    state = 1;
+    expect(SESSION::set_param(SESSION::PARAM_STORE, &state, 1), "SET_PARAMETER STORE 1");
+    for (uint32_t addr = 0; addr < image_size; addr += config->flash_page) {
+      expect(SESSION::write_page(SESSION::MTYPE_XMEGA_FLASH,
+        config->flash_base + addr, &image[addr], config->flash_page), "WRITE_MEMORY");
+    }
+    expect(store_is(1, pages), "GET STORE while recording");
+    state = 2;
+    expect(SESSION::set_param(SESSION::PARAM_STORE, &state, 1), "SET_PARAMETER STORE 2");
+    expect(store_is(2, pages), "GET STORE after arming");
+    expect(SESSION::leave(), "SIGN_OFF");
+    SESSION::close();
+    HOST::wait_us(100000);
+    expect(flash_is(image), "recorded session did not program the target");
+
+    /* armed, strap open : a host opening the port does not replay */
+    swap_target(0x21);
+    HOST::make_pulse();
+    HOST::wait_us(3000000);
+    expect(flash_is(other), "MAKE with the strap open replayed the store");
+
+    /* armed, strap low : the MAKE signal replays the store */
+    swap_target(0x42);
+    HOST::set_strap(true);
+    HOST::make_pulse();
+    HOST::wait_us(3000000);
+    expect(flash_is(image), "MAKE with the strap low did not replay the store");
+    bool blank = true;
+    for (uint32_t i = image_size; i < config->flash_size; i++) blank &= TARGET::flash()[i] == 0xFF;
+    expect(blank, "replay did not erase the rest of the flash");
+
+    /* a second target on the same fixture */
+    swap_target(0x63);
+    HOST::make_pulse();
+    HOST::wait_us(3000000);
+    expect(flash_is(image), "second replay did not program the target");
+    HOST::set_strap(false);
+  }
+}
+
+int main (void) {
+  using namespace STORE_TEST;
+  config = TARGET::find("dx");
+  TARGET::setup(config);
+  SESSION::make_image(config->flash_page * 32, 0x5709E);
+  other = (uint8_t*) malloc(image_size);
+  SIM::run(script);
+  return SESSION::finish();
+}
+
+// end of code
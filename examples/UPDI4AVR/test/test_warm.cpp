@@ -0,0 +1,92 @@
+/**
+ * @file test_warm.cpp
+ * @author UPDI4AVR contributors
+ * @brief ENABLE_WARM_ENTRY : cold and warm entry time of back to back sessions
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026 UPDI4AVR contributors, MIT License (see LICENSE)
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+#include "target.h"
+#include "session.h"
+
+namespace WARM {
+  using SESSION::config;
+  using SESSION::expect;
+
+  struct entry_t {
+    const char *name;
+    uint64_t ready_us;      /* port open to the ENTER_PROGMODE answer */
+    uint64_t sign_on_us;
+    uint64_t enter_us;
+    uint32_t resets;        /* reset pulses seen by the target */
+  } entry[4];
+
+  /* One avrdude run : verify a block, optionally erase and write a page */
+  void session (entry_t &e, const char *name, bool erase) {
+    static uint8_t data[512];
+    uint8_t sig[3];
+    memset(SESSION::latency, 0, sizeof(SESSION::latency));
+    e.name = name;
+    uint32_t resets = TARGET::resets();
+    uint64_t start = HOST::time_us();
+    SESSION::start();
+    e.ready_us = HOST::time_us() - start;
+    e.resets = TARGET::resets() - resets;
+    e.sign_on_us = SESSION::latency[SESSION::CMND_GET_SIGN_ON].max_us;
+    e.enter_us = SESSION::latency[SESSION::CMND_ENTER_PROGMODE].max_us;
+    expect(SESSION::read_signature(config, sig) && memcmp(sig, config->signature, 3) == 0, "signature");
+    expect(SESSION::read_block(SESSION::MTYPE_FLASH_PAGE, config->flash_base, data, config->flash_page)
+      && memcmp(data, TARGET::flash(), config->flash_page) == 0, "flash read");
+    if (erase) {
+      for (uint16_t i = 0; i < config->flash_page; i++) data[i] = i * 7;
+      expect(SESSION::erase(), "XMEGA_ERASE");
+      expect(SESSION::write_page(SESSION::MTYPE_XMEGA_FLASH, config->flash_base, data, config->flash_page),
+        "WRITE_MEMORY");
+    }
+    expect(SESSION::leave(), "SIGN_OFF");
+    /* a posted write is answered early : it has landed by the SIGN_OFF answer */
+    if (erase) expect(memcmp(data, TARGET::flash(), config->flash_page) == 0, "flash write");
+    SESSION::close();
+    HOST::wait_us(100000);
+  }
+
+  void script (void) {
+    session(entry[0], "cold", false);
+    expect(TARGET::in_nvmprog(), "target not held in NVMPROG after a clean session");
+    session(entry[1], "warm", true);
+    expect(entry[1].resets == 0, "warm entry pulsed the reset");
+    /* a chip erase ends with a reset : nothing is held */
+    expect(!TARGET::in_nvmprog(), "target held in NVMPROG after a chip erase");
+    session(entry[2], "after erase", false);
+    /* a new target : NVMPROG was lost, the warm probe must fall back */
+    TARGET::power_cycle();
+    session(entry[3], "new target", false);
+  }
+}
+
+int main (void) {
+  using namespace WARM;
+  config = TARGET::find("dx");
+  TARGET::setup(config);
+  TARGET::fill(0x77);
+  SIM::run(script);
+
+  printf("%-12s %12s %12s %12s %7s\n", "session", "ready us", "sign on us", "enter us", "resets");
+  for (auto &e : entry) {
+    printf("%-12s %12llu %12llu %12llu %7u\n", e.name, (unsigned long long) e.ready_us,
+      (unsigned long long) e.sign_on_us, (unsigned long long) e.enter_us, e.resets);
+  }
+  if (entry[1].ready_us < entry[0].ready_us) {
+    printf("warm entry saves %llu us\n", (unsigned long long)(entry[0].ready_us - entry[1].ready_us));
+  }
+  expect(entry[1].ready_us < entry[0].ready_us, "warm entry is not faster than cold");
+  expect(entry[2].resets > 0 && entry[3].resets > 0, "cold entry without a reset pulse");
+  return SESSION::finish();
+}
+
+// end of code